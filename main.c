@@ -8,10 +8,55 @@
 #include <strings.h>
 #include <time.h>
 
+// FLOAT LANES OF THE TARGET: 8 WITH AVX (-mavx/-mavx2), 4 WITH SSE2, 0 == THE KERNELS ONLY RUN THEIR SCALAR LOOP
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LANES 8
+typedef __m256 Lanes;
+#define LANES_LOAD(P) _mm256_loadu_ps(P)
+#define LANES_STORE(P, A) _mm256_storeu_ps(P, A)
+#define LANES_SET(F) _mm256_set1_ps(F)
+#define LANES_ADD(A, B) _mm256_add_ps(A, B)
+#define LANES_SUB(A, B) _mm256_sub_ps(A, B)
+#define LANES_MUL(A, B) _mm256_mul_ps(A, B)
+#define LANES_DIV(A, B) _mm256_div_ps(A, B)
+#define LANES_AND(A, B) _mm256_and_ps(A, B)
+#define LANES_ANDNOT(A, B) _mm256_andnot_ps(A, B)
+#define LANES_OR(A, B) _mm256_or_ps(A, B)
+#define LANES_GE(A, B) _mm256_cmp_ps(A, B, _CMP_GE_OQ)
+#define LANES_LE(A, B) _mm256_cmp_ps(A, B, _CMP_LE_OQ)
+#define LANES_LT(A, B) _mm256_cmp_ps(A, B, _CMP_LT_OQ)
+#define LANES_MASK(A) _mm256_movemask_ps(A)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define LANES 4
+typedef __m128 Lanes;
+#define LANES_LOAD(P) _mm_loadu_ps(P)
+#define LANES_STORE(P, A) _mm_storeu_ps(P, A)
+#define LANES_SET(F) _mm_set1_ps(F)
+#define LANES_ADD(A, B) _mm_add_ps(A, B)
+#define LANES_SUB(A, B) _mm_sub_ps(A, B)
+#define LANES_MUL(A, B) _mm_mul_ps(A, B)
+#define LANES_DIV(A, B) _mm_div_ps(A, B)
+#define LANES_AND(A, B) _mm_and_ps(A, B)
+#define LANES_ANDNOT(A, B) _mm_andnot_ps(A, B)
+#define LANES_OR(A, B) _mm_or_ps(A, B)
+#define LANES_GE(A, B) _mm_cmpge_ps(A, B)
+#define LANES_LE(A, B) _mm_cmple_ps(A, B)
+#define LANES_LT(A, B) _mm_cmplt_ps(A, B)
+#define LANES_MASK(A) _mm_movemask_ps(A)
+#else
+#define LANES 0
+#endif
+// MASK ? A : B
+#define LANES_SELECT(MASK, A, B) LANES_OR(LANES_AND(MASK, A), LANES_ANDNOT(MASK, B))
+
 
 // GAME/WINDOW RELATED VALUES
 #define FACTOR 120 // window size factor
-#define FPS 60
+#define FPS 60 // frame rate cap, rendering only
+#define TICK_RATE 60 // simulation steps per second, whatever the frame rate
+#define MAX_TICKS_PER_FRAME 4 // a slower frame drops the rest of its time, the game slows down instead of stalling
 #define START_SPEED 4
 #define SPEED_CAP 0.f
 #define INCREMENTAL_SPEED 0.08f
@@ -51,12 +96,134 @@
 #define P_FRICTION 60 // minimum  = 1 == NO FRICTION, >infinity == MAXIMUM FRICTION  
 #define SPREAD 12.0f
 #define VERTICAL_BUMP 10.0f
-
-#define START_DA_SIZE 20 // dynamic array size when initialized
+#define P_GROUND (WINDOW_HEIGHT - SOIL_Y + 10) // particles bounce when they reach it
+#define PARTICLE_POOL 65536 // particles alive at the same time, multiple of 64
+
+// SPRITE ATLAS RELATED VALUES
+#define ATLAS_W 2048
+#define ATLAS_PADDING 2 // transparent pixels between two sprites, keeps filtering from bleeding
+#define BATCH_START_QUADS 1024 // quad capacity of the frame batch, doubled when a frame needs more
+
+// COLLISION MASK RELATED VALUES
+#define MASK_ALPHA 128 // pixels at least this opaque are solid for collisions
+
+// ROTATION CACHE RELATED VALUES
+#define ROTATION_STEPS 128 // pre-rotated frames of the gun and the bullet, 0 == rotate every copy
+
+// DIRTY RECTS RELATED VALUES
+#define DIRTY_TILE (FACTOR/2) // damage is tracked on a grid of DIRTY_TILE x DIRTY_TILE pixels
+#define DIRTY_TILES_X (WINDOW_WIDTH/DIRTY_TILE)
+#define DIRTY_TILES_Y (WINDOW_HEIGHT/DIRTY_TILE)
+#define DIRTY_FULL_PERCENT 60 // above this share of damaged tiles the whole window is repainted
+
+// TEXT RELATED VALUES
+#define FONT_SIZE 120
+#define HUD_CHARSET "0123456789SCOREAM: " // every char display_points and display_ammo can draw
+#define HUD_MAX_GLYPHS 32 // "SCORE: " + the 20 digits of a 64 bit size_t + '\0'
+
+// PROFILER RELATED VALUES
+#define PROF_WINDOW 120 // frames kept for the rolling min/avg/p99 and the frame-time graph
+#define PROF_FONT_SIZE 20
+#define PROF_GRAPH_H FACTOR // graph height, the frame budget (1000/FPS ms) is drawn at half of it
+
+// FRAME PACING RELATED VALUES
+#define PACE_SPIN_MIN_US 200 // the pacer always spins at least this long before a deadline
+#define PACE_SPIN_MAX_US 4000 // and never longer than this, however late SDL_Delay wakes up
+
+// IDLE SCREENS RELATED VALUES
+#define IDLE_WAIT_MS 500 // longest a menu, paused or hidden window sleeps without an event
+
+// BENCHMARK RELATED VALUES
+#define BENCH_FRAMES 3000 // frames simulated by --bench when --frames is not given
+#define BENCH_SEED 56
+#define BENCH_SHOT_EVERY 12 // frames between two scripted shots
+#define BENCH_COLLISIONS_MAX 1024 // --bench-collisions doubles entities and bullets from 1 up to this
+#define BENCH_COLLISIONS_PAIRS 50000000 // entity-bullet pairs tested per size, sets the repetitions
+
+// TIMER WHEEL RELATED VALUES
+#define WHEEL_SLOTS 256 // slots of the timer wheel
+#define WHEEL_TICK 8 // ms of game time per slot, a timer further than WHEEL_SLOTS*WHEEL_TICK ms waits more laps
+
+#define MAX_ENTITIES 1024 // capacity of the entity store
+#define ARENA_ALIGN 64 // every arena allocation starts on a cache line
+#define MAX_BULLETS 1024 // capacity of the bullet pool, multiple of 64
+#define SWEEP_MIN_PAIRS 128 // entity x bullet pairs from which sort and sweep beats the plain loop, see --bench-collisions
 #define PI 3.14159265358979323846
 
-float SPEED = START_SPEED/(FPS/60.0f);
-float BULLET_SPEED = START_SPEED_B/(FPS/60.0f);
+// PIXELS PER SIMULATION TICK, THE START VALUES ARE TUNED FOR 60 TICKS PER SECOND
+float SPEED = START_SPEED/(TICK_RATE/60.0f);
+float BULLET_SPEED = START_SPEED_B/(TICK_RATE/60.0f);
+
+// when true the frame clock advances by exactly 1/FPS s per loop instead of following SDL_GetPerformanceCounter()
+bool VIRTUAL_CLOCK = false;
+Uint64 VIRTUAL_COUNTER = 0;
+
+// CHROME TRACE-EVENT EXPORT, BUILD WITH -DTRACE (make trace) AND OPEN trace.json IN ui.perfetto.dev OR chrome://tracing
+#ifdef TRACE
+#define TRACE_FILE "trace.json"
+#define TRACE_BUFFER (1 << 20)
+
+FILE *TRACE_OUT = NULL;
+Uint64 TRACE_T0 = 0;
+
+double trace_ts() {
+    return (double)(SDL_GetPerformanceCounter() - TRACE_T0)*1000000.0/SDL_GetPerformanceFrequency();
+}
+
+void trace_open() {
+    TRACE_OUT = fopen(TRACE_FILE, "w");
+    if (TRACE_OUT == NULL) {
+        printf("Could not open %s\n", TRACE_FILE);
+        return;
+    }
+    setvbuf(TRACE_OUT, NULL, _IOFBF, TRACE_BUFFER);
+    TRACE_T0 = SDL_GetPerformanceCounter();
+    fprintf(TRACE_OUT, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Texas T-REX\"}}");
+}
+
+void trace_close() {
+    if (TRACE_OUT == NULL) return;
+    fprintf(TRACE_OUT, "\n]\n");
+    fclose(TRACE_OUT);
+    TRACE_OUT = NULL;
+}
+
+void trace_event(const char *name, char ph) {
+    if (TRACE_OUT == NULL) return;
+    fprintf(TRACE_OUT, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":1%s}", name, ph, trace_ts(), ph == 'i' ? ",\"s\":\"g\"" : "");
+}
+
+void trace_counter(const char *name, double value) {
+    if (TRACE_OUT == NULL) return;
+    fprintf(TRACE_OUT, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"value\":%g}}", name, trace_ts(), value);
+}
+
+#define TRACE_OPEN() trace_open()
+#define TRACE_CLOSE() trace_close()
+#define TRACE_BEGIN(NAME) trace_event((NAME), 'B')
+#define TRACE_END(NAME) trace_event((NAME), 'E')
+#define TRACE_INSTANT(NAME) trace_event((NAME), 'i')
+#define TRACE_COUNTER(NAME, VALUE) trace_counter((NAME), (VALUE))
+#else
+#define TRACE_OPEN() ((void)0)
+#define TRACE_CLOSE() ((void)0)
+#define TRACE_BEGIN(NAME) ((void)0)
+#define TRACE_END(NAME) ((void)0)
+#define TRACE_INSTANT(NAME) ((void)0)
+#define TRACE_COUNTER(NAME, VALUE) ((void)0)
+#endif
+
+#define TRACE_ZONE(NAME, CODE) do { \
+    TRACE_BEGIN(NAME);              \
+    CODE;                           \
+    TRACE_END(NAME);                \
+    } while (0)
+
+#define PROFILE(PHASE, CODE) do {                                   \
+    Uint64 _start = SDL_GetPerformanceCounter();                    \
+    TRACE_ZONE(PHASE_NAMES[PHASE], CODE);                           \
+    PROF.current[PHASE] += SDL_GetPerformanceCounter() - _start;    \
+    } while (0)
 
 #define LOG(...) (SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_INFO, __VA_ARGS__))
 #define UNREACHABLE() do {printf("UNREACHABLE, LINE: %d", __LINE__); exit(1);} while (0);
@@ -84,11 +251,86 @@ typedef struct {
     float y;
 } Vec2f;
 
+typedef enum {
+    SPRITE_BACK_1,
+    SPRITE_BACK_2,
+    SPRITE_BACK_3,
+    SPRITE_DINO_L,
+    SPRITE_DINO_R,
+    SPRITE_GUN,
+    SPRITE_GSIGHT,
+    SPRITE_BIRD_DOWN,
+    SPRITE_BIRD_UP,
+    SPRITE_CACTUS_1,
+    SPRITE_CACTUS_2,
+    SPRITE_CACTUS_3,
+    SPRITE_CLOUD,
+    SPRITE_BULLET,
+    SPRITE_VOL_MAX,
+    SPRITE_VOL_MID,
+    SPRITE_VOL_LOW,
+    SPRITE_VOL_ZERO,
+    N_SPRITES
+} SpriteId;
+
+typedef struct {
+    const char *path;
+    int h; // rows of the image that are drawn, 0 == all of them
+    int dst_w; // size the sprite is drawn at, the image is scaled to it once at load time
+    int dst_h;
+} SpriteSource;
+
+const SpriteSource SPRITE_SOURCES[N_SPRITES] = {
+    [SPRITE_BACK_1] = {"./assets/img/back_1.png", 60, WINDOW_WIDTH, SOIL_HEIGHT},
+    [SPRITE_BACK_2] = {"./assets/img/back_2.png", 60, WINDOW_WIDTH, SOIL_HEIGHT},
+    [SPRITE_BACK_3] = {"./assets/img/back_3.png", 60, WINDOW_WIDTH, SOIL_HEIGHT},
+    [SPRITE_DINO_L] = {"./assets/img/dino_l.png", 0, DINO_W, DINO_H},
+    [SPRITE_DINO_R] = {"./assets/img/dino_r.png", 0, DINO_W, DINO_H},
+    [SPRITE_GUN] = {"./assets/img/gun.png", 0, GUN_W, GUN_H},
+    [SPRITE_GSIGHT] = {"./assets/img/sight.png", 0, GSIGHT_W, GSIGHT_H},
+    [SPRITE_BIRD_DOWN] = {"./assets/img/bird_down.png", 0, BIRD_W, BIRD_H},
+    [SPRITE_BIRD_UP] = {"./assets/img/bird_up.png", 0, BIRD_W, BIRD_H},
+    [SPRITE_CACTUS_1] = {"./assets/img/cactus_1.png", 0, CACTUS_1W, CACTUS_H},
+    [SPRITE_CACTUS_2] = {"./assets/img/cactus_2.png", 0, CACTUS_2W, CACTUS_H},
+    [SPRITE_CACTUS_3] = {"./assets/img/cactus_3.png", 0, CACTUS_3W, CACTUS_H},
+    [SPRITE_CLOUD] = {"./assets/img/cloud.png", 0, CLOUD_W, CLOUD_H},
+    [SPRITE_BULLET] = {"./assets/img/bullet.png", 0, BULLET_W, BULLET_H},
+    [SPRITE_VOL_MAX] = {"./assets/img/vol_max.png", 0, VOLUME_W, VOLUME_H},
+    [SPRITE_VOL_MID] = {"./assets/img/vol_mid.png", 0, VOLUME_W, VOLUME_H},
+    [SPRITE_VOL_LOW] = {"./assets/img/vol_low.png", 0, VOLUME_W, VOLUME_H},
+    [SPRITE_VOL_ZERO] = {"./assets/img/vol_zero.png", 0, VOLUME_W, VOLUME_H},
+};
+
+// ONE BIT PER PIXEL OF THE SPRITE AT ITS DRAWN SIZE, SET WHERE IT'S OPAQUE. ROWS ARE words Uint64 LONG,
+// BIT k OF WORD j IS PIXEL 64*j + k, THE BITS PAST w ARE ALWAYS 0
+typedef struct {
+    Uint64 *bits; // NULL == NO MASK, THE WHOLE RECT IS SOLID
+    int w;
+    int h;
+    int words;
+} CollisionMask;
+
+typedef struct {
+    SDL_Texture *txt;
+    SDL_Surface *srfs[N_SPRITES];
+    SDL_Rect rects[N_SPRITES]; // where every sprite lives in txt
+    CollisionMask masks[N_SPRITES];
+} SpriteAtlas;
+
+// EVERY ROTATED SPRITE PRE-RENDERED AT steps ANGLES, FRAMES ARE ROTATED AROUND THE SPRITE'S CENTER
+typedef struct {
+    SDL_Texture *txt;
+    int steps;
+    SDL_Rect *frames[N_SPRITES]; // steps rects in txt, NULL == sprite not cached
+} RotationCache;
+
 typedef struct {
     SDL_Rect src;  
     SDL_FRect dst;
     SDL_Surface *srf;
     SDL_Texture *txt;
+    SpriteId sprite;
+    float prev_x; // dst.x at the previous tick, only kept for the scrolling soil
 } Asset;
 
 typedef struct {
@@ -101,17 +343,16 @@ typedef struct {
 } AssetRot;
 
 typedef struct {
+    SpriteAtlas Atlas;
+    RotationCache Rotations;
+
     Asset *Dino;
-    SDL_Texture *Dinos_txt;
-    SDL_Surface *Dinos_srf;
 
     Asset *Gun;
     Asset *Gsight;
 
     Asset *Back_1;
     Asset *Back_2;
-    Asset *Back_3;
-    SDL_Texture *Backs[3];
 
     Asset *Bird_Up;
     Asset *Bird_Down;
@@ -123,71 +364,106 @@ typedef struct {
     Asset *Cloud;
     AssetRot *Bullet;
 
-    Asset *Volume_max;
-    Asset *Volume_mid;
-    Asset *Volume_low;
-    Asset *Volume_zero;
     Asset *Vol;
 
 } Assets;
 
+typedef enum {
+    TIMER_BIRD_SPAWN,
+    TIMER_CACTUS_SPAWN,
+    TIMER_CLOUD_SPAWN,
+    TIMER_DINO_STEP,
+    TIMER_BIRD_FLAP,
+    TIMER_AMMO,
+    N_TIMERS
+} TimerId;
+
+// HASHED TIMER WHEEL OVER GAME TIME: EVERY TIMER SITS IN THE SLOT OF ITS DEADLINE, ONLY THE SLOTS THE CLOCK
+// WENT THROUGH ARE VISITED. GAME TIME ONLY MOVES WITH THE SIMULATION TICKS, SO IT STANDS STILL WHILE THE GAME IS PAUSED OR OVER
 typedef struct {
-    size_t Dino_start;
-    size_t Bird_spawn;
-    size_t Bird_flap;
-    size_t Cactus_spawn;
-    size_t Cloud_spawn;
-    size_t Last_added_bullet;
-} Animations_start;
+    int slots[WHEEL_SLOTS]; // first timer of every slot, -1 == empty
+    int next[N_TIMERS]; // next timer in the same slot, -1 == last
+    size_t deadline[N_TIMERS]; // ms of game time
+    Uint32 fired; // bit per timer that fired and wasn't taken yet
+    size_t ticks; // simulation ticks since the last reset
+    size_t now; // game time in ms
+    size_t tick; // now/WHEEL_TICK, the slots before it are done
+} TimerWheel;
+
+// FIXED TIMESTEP: FRAME TIME IS BANKED IN acc AND SPENT IN TICKS OF 1/TICK_RATE S, RENDERING BLENDS THE LAST TWO TICKS BY alpha
+typedef struct {
+    Uint64 last; // performance counter of the last frame
+    Uint64 acc; // counter ticks not simulated yet
+    Uint64 tick; // counter ticks per simulation tick
+    float alpha; // 0 == the previous tick, 1 == the current one
+} SimClock;
 
+typedef enum {
+    ENTITY_BIRD,
+    ENTITY_CACTUS,
+    ENTITY_CLOUD,
+    N_ENTITY_TYPES
+} EntityType;
+
+// SPRITE OF FRAME 0 OF EVERY TYPE, THE FRAME INDEX IS ADDED TO IT (BIRD: DOWN/UP, CACTUS: THE 3 VARIANTS)
+const SpriteId ENTITY_SPRITES[N_ENTITY_TYPES] = {
+    [ENTITY_BIRD] = SPRITE_BIRD_DOWN,
+    [ENTITY_CACTUS] = SPRITE_CACTUS_1,
+    [ENTITY_CLOUD] = SPRITE_CLOUD,
+};
+
+// BIRDS, CACTI AND CLOUDS, PACKED: THE FIRST count SLOTS OF EVERY ARRAY ARE LIVE, REMOVING MOVES THE LAST ONE IN THE HOLE
 typedef struct {
-    Asset **data;
-    size_t size;
+    float *x;
+    float *y;
+    float *px; // position at the previous tick, for the interpolation
+    float *py;
+    float *w;
+    float *h;
+    EntityType *type;
+    Uint8 *frame;
+    int *hit; // scratch of the collision pass, bullet that hit every entity, -1 == none
     size_t count;
-} DArrayOfEntities;
+    size_t size; // MAX_ENTITIES
+} EntityStore;
 
+// LIVE BULLETS ARE THE FIRST count SLOTS, VELOCITY IS FIXED AT SPAWN, angle IS ONLY USED TO DRAW THEM
 typedef struct {
-    AssetRot **data;
-    size_t size;
+    float x[MAX_BULLETS];
+    float y[MAX_BULLETS];
+    float px[MAX_BULLETS]; // position at the previous tick, for the interpolation
+    float py[MAX_BULLETS];
+    float vx[MAX_BULLETS];
+    float vy[MAX_BULLETS];
+    float angle[MAX_BULLETS];
     size_t count;
-} DArrayOfBullets;
-
-typedef struct{
-    SDL_FRect dst;
-    Vec2f vel;
-    size_t ground_h;
-} Particle;
+} BulletPool;
 
+// EVERY PARTICLE IS PARTICLE_SIZE WIDE AND HIGH, LIVE ONES ARE THE FIRST count SLOTS
 typedef struct {
-    Particle **data;
-    int cx;
-    int cy;
+    float x[PARTICLE_POOL];
+    float y[PARTICLE_POOL];
+    float px[PARTICLE_POOL]; // position at the previous tick, for the interpolation
+    float py[PARTICLE_POOL];
+    float vx[PARTICLE_POOL];
+    float vy[PARTICLE_POOL];
     size_t count;
-    size_t size;
-} DArrayOfParticles;
+} ParticlePool;
 
+// BUMP ALLOCATOR, MEMORY IS ONLY GIVEN BACK ALL AT ONCE
 typedef struct {
-    DArrayOfParticles **data;
-    size_t count;
+    Uint8 *base;
     size_t size;
-} DArrayOfParticlesCLusters;
-
-typedef enum {
-    DA_TYPE_ENTITIES,
-    DA_TYPE_BULLETS,
-    DA_TYPE_PARTICLES,
-    DA_TYPE_CLUSTERS
-} DAtype;
+    size_t used;
+} Arena;
 
+// EVERY OBJECT OF ONE GAME, CARVED OUT OF ONE ARENA OF FIXED SIZE: A RESTART DROPS THEM ALL WITH ONE arena_reset
 typedef struct {
-    union {
-        DArrayOfEntities *DAe;
-        DArrayOfBullets *DAb;
-        DArrayOfParticles *DAp;
-        DArrayOfParticlesCLusters *DApc;
-    } ptr;
-    DAtype type;
-} DA;
+    Arena arena;
+    EntityStore Entities;
+    BulletPool *Bullets;
+    ParticlePool *Particles;
+} Session;
 
 typedef struct {
     int VOLUME;
@@ -199,8 +475,244 @@ typedef struct {
     bool PAUSE;
     bool RESTART;
     bool GAMEOVER;
+    bool LATE_LATCH; // gun and sight are drawn after everything else, from a mouse read right before present
+    bool HW_CURSOR; // the OS draws the sight as the cursor
+    bool HIDDEN; // window minimized or hidden, nothing is drawn
+    bool IDLE; // this frame is the cached idle screen plus gun and sight
 } State;
 
+typedef struct {
+    SDL_Texture *txt; // NULL == solid rects filled with color
+    SDL_Color color;
+    int first; // first quad of the run
+    int count;
+} BatchRun;
+
+// EVERYTHING DRAWN IN A FRAME, IN ORDER, SPLIT IN RUNS OF QUADS SHARING A TEXTURE
+typedef struct {
+    SDL_Renderer *renderer;
+    SDL_Window *window;
+    bool DIRTY; // software renderer on the window surface, only the damaged regions are repainted and presented
+    bool FULL_REDRAW; // the next dirty flush repaints the whole window
+    float txt_w; // size of the texture of the last run
+    float txt_h;
+
+    SDL_Vertex *vertices;
+    SDL_FRect *bounds; // screen bounding box of every quad
+    Uint64 *keys; // hash of every quad, only in DIRTY mode
+    int *indices;
+    int n_quads;
+    int cap_quads;
+    BatchRun *runs;
+    int n_runs;
+    int cap_runs;
+
+    Uint64 *prev_keys; // sorted keys of the last frame
+    SDL_FRect *prev_bounds;
+    int n_prev;
+    Uint64 *sorted_keys;
+    int *scratch_indices;
+    SDL_FRect *scratch_rects;
+    bool tiles[DIRTY_TILES_Y][DIRTY_TILES_X];
+    SDL_Rect regions[DIRTY_TILES_X*DIRTY_TILES_Y];
+    int n_regions;
+
+    size_t flushes; // SDL_RenderGeometry/SDL_RenderFillRectsF calls since start
+    Uint64 repainted; // pixels repainted since start, only in DIRTY mode
+} SpriteBatch;
+
+typedef struct {
+    SDL_Texture *txt;
+    SDL_Rect glyphs[128]; // atlas rect of each ASCII char of HUD_CHARSET, w == 0 if not in the atlas
+    int height;
+} GlyphAtlas;
+
+typedef struct {
+    SDL_Rect src[HUD_MAX_GLYPHS];
+    SDL_FRect dst[HUD_MAX_GLYPHS];
+    int n;
+    size_t value; // value the glyphs were laid out for
+    bool valid;
+} HudLine;
+
+typedef enum {
+    TEXT_MENU,
+    TEXT_START,
+    TEXT_PAUSE,
+    TEXT_GAMEOVER,
+    TEXT_GAMEOVER_SUB,
+    N_TEXTS
+} TextId;
+
+typedef struct {
+    const char *text;
+    bool wrapped;
+} StaticText;
+
+const StaticText STATIC_TEXTS[N_TEXTS] = {
+    [TEXT_MENU] = {"Press [ESC] to pause or exit (if already paused)\n\
+Press [SPACE] to shoot\n\
+Press [P] to pause or resume\n\
+Press [R] to restart\n\
+Press [ARROW UP] to increase volume\n\
+Press [ARROW DOWN] to decrease volume\n\
+Press [M] to mute volume", true},
+    [TEXT_START] = {"PRESS SPACE TO START", false},
+    [TEXT_PAUSE] = {"PAUSE", false},
+    [TEXT_GAMEOVER] = {"GAMEOVER!", true},
+    [TEXT_GAMEOVER_SUB] = {"press [R] to restart or [ESC] to exit", true},
+};
+
+typedef struct {
+    TTF_Font *font;
+    GlyphAtlas glyphs;
+    HudLine points;
+    HudLine ammo;
+    SDL_Texture *screens[N_TEXTS]; // rendered on first use
+    TTF_Font *built_font; // font the cache was built for, the texts are drawn in logical coordinates so the output size doesn't matter
+} TextCache;
+
+typedef enum {
+    PHASE_EVENTS,
+    PHASE_SPAWN,
+    PHASE_ANIMATE,
+    PHASE_COLLISIONS,
+    PHASE_DISPLAY_SCENE,
+    PHASE_DISPLAY_ENTITIES,
+    PHASE_DISPLAY_BULLETS,
+    PHASE_DISPLAY_PARTICLES,
+    PHASE_DISPLAY_POINTS,
+    PHASE_DISPLAY_AMMO,
+    PHASE_DISPLAY_GSIGHT,
+    PHASE_DISPLAY_START,
+    PHASE_DISPLAY_MENU,
+    PHASE_DISPLAY_PAUSE,
+    PHASE_DISPLAY_GAMEOVER,
+    PHASE_BATCH_FLUSH,
+    PHASE_DISPLAY_PROFILER,
+    PHASE_PRESENT,
+    PHASE_FRAME, // whole loop iteration without the pacer's wait
+    PHASE_PACE_ERROR, // how far past its deadline the last frame ended
+    PHASE_FRAME_INTERVAL, // start of the last frame to start of this one
+    N_PHASES
+} Phase;
+
+const char *PHASE_NAMES[N_PHASES] = {
+    "manage_events",
+    "spawn_entities",
+    "animate",
+    "check_bcollisions",
+    "display_scene",
+    "display_entities",
+    "display_bullets",
+    "display_particles",
+    "display_points",
+    "display_ammo",
+    "display_gsight",
+    "display_start",
+    "display_menu",
+    "display_pause",
+    "display_gameover",
+    "batch_flush",
+    "display_profiler",
+    "RenderPresent",
+    "frame",
+    "pace_error",
+    "frame_interval",
+};
+
+typedef enum {
+    LATENCY_SHOT, // SPACE keydown to the present of the frame that handled it
+    LATENCY_AIM, // first mouse motion of a frame to its present
+    N_LATENCIES
+} Latency;
+
+const char *LATENCY_NAMES[N_LATENCIES] = {
+    "space_to_present",
+    "move_to_present",
+};
+
+typedef struct {
+    Uint64 samples[N_PHASES][PROF_WINDOW];
+    Uint64 current[N_PHASES];
+    Uint64 totals[N_PHASES];
+    size_t head; // next slot of samples to be written
+    size_t filled;
+    size_t frames;
+    Uint64 latency[N_LATENCIES][PROF_WINDOW]; // only frames with that input add a sample
+    size_t latency_head[N_LATENCIES];
+    size_t latency_filled[N_LATENCIES];
+    Uint64 latency_totals[N_LATENCIES];
+    size_t latency_count[N_LATENCIES];
+    bool SHOW;
+    TTF_Font *font;
+} Profiler;
+
+// INPUT OF THE CURRENT FRAME, SAMPLED ONCE BY manage_events SO EVERY PART OF THE FRAME SEES THE SAME MOUSE.
+// EVENT TIMES ARE PERFORMANCE COUNTER VALUES, 0 == NO SUCH EVENT THIS FRAME
+typedef struct {
+    int mouse_x;
+    int mouse_y;
+    Uint64 shot_time;
+    Uint64 move_time;
+    bool redraw; // a key, the window or lost render targets: an idle screen has to be drawn again
+} Input;
+
+// LAST FRAME OF THE START/PAUSE/GAMEOVER SCREEN WITHOUT GUN, SIGHT AND TEXT, DRAWN AGAIN ONLY WHEN WHAT IT SHOWS CHANGES
+typedef struct {
+    SDL_Texture *txt; // NULL == NO CACHE (NO RENDER TARGETS OR DIRTY RECTS), THE SCREEN IS DRAWN AS USUAL
+    bool VALID;
+    bool PRESENTED; // the screen on the window is up to date, the next frame waits for an event
+} IdleScreen;
+
+// ENDS EVERY FRAME period AFTER THE LAST DEADLINE: SDL_Delay UNTIL spin BEFORE IT, THEN A SPIN ON THE PERFORMANCE COUNTER
+typedef struct {
+    Uint64 period; // counter ticks per frame, 1/FPS s
+    Uint64 deadline; // counter value the current frame ends at
+    Uint64 spin; // follows how late SDL_Delay wakes up
+    Uint64 oversleep; // moving average of how much later than asked SDL_Delay returned
+    Uint64 error; // how far past its deadline the last frame ended, in counter ticks
+} FramePacer;
+
+typedef struct {
+    bool BENCH;
+    size_t FRAMES;
+    unsigned int SEED;
+    const char *RENDERER; // "auto", an SDL render driver name ("software", "opengl", "opengles2", ...) or "all" to bench each of them
+    bool VSYNC;
+    bool TARGET_TEXTURE; // draw the frame into a texture, then copy it to the window
+    bool DIRTY_RECTS; // software rendering straight into the window surface, only what changed is repainted
+    int ROTATIONS; // steps of the rotation cache, 0 == off
+    bool BENCH_COLLISIONS; // only run the collision microbenchmark
+    bool LATE_LATCH;
+    bool HW_CURSOR;
+} Options;
+
+typedef struct {
+    Uint64 *handle_times;
+    size_t frames;
+    Uint64 start;
+    Uint64 end;
+    char renderer[32]; // backend that actually ran
+    double fps;
+    double handle_avg;
+    double handle_p99;
+} Bench;
+
+// PCG32 (XSH RR) STATE, inc IS ODD AND PICKS THE SEQUENCE
+typedef struct {
+    Uint64 state;
+    Uint64 inc;
+} Rng;
+
+// ONE GENERATOR PER USE, SO A NEW COSMETIC EFFECT NEVER SHIFTS THE NUMBERS THE GAMEPLAY DRAWS
+typedef enum {
+    RNG_SPAWN, // spawn intervals and positions, the birds' steering
+    RNG_VISUALS, // soil tiles
+    RNG_PARTICLES,
+    N_RNG_STREAMS
+} RngStream;
+
 typedef struct{
     Mix_Chunk *shot_sound;
     Mix_Chunk *stepl_sound;
@@ -210,258 +722,1019 @@ typedef struct{
     Mix_Chunk *cactus_death_sound;
 } Sounds;
 
-#define DA_INIT_CASE(TYPE, MEMBER)                                                                  \
-    if (DA->type == TYPE) {                                                                         \
-        typeof(DA->ptr.MEMBER) d = (typeof(DA->ptr.MEMBER))malloc(sizeof(typeof(*DA->ptr.MEMBER))); \
-        d->count = 0;                                                                               \
-        d->size = START_DA_SIZE;                                                                    \
-        d->data = (typeof(d->data))malloc(sizeof(typeof(*d->data))*START_DA_SIZE);                  \
-        memset(d->data, 0, sizeof(d->data)*START_DA_SIZE);                                          \
-        DA->ptr.MEMBER = d;                                                                         \
-        return;                                                                                     \
+Profiler PROF = {0};
+SpriteBatch BATCH = {0};
+Rng RNG[N_RNG_STREAMS] = {0};
+Input INPUT = {0};
+
+static inline Uint32 rng_next(RngStream stream) {
+    Rng *r = &RNG[stream];
+    Uint64 old = r->state;
+    r->state = old*6364136223846793005ULL + r->inc;
+    Uint32 xorshifted = ((old >> 18) ^ old) >> 27;
+    Uint32 rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << (-rot & 31));
+}
+
+// UNIFORM IN [0, n), A MULTIPLY INSTEAD OF A DIVISION
+static inline Uint32 rng_below(RngStream stream, Uint32 n) {
+    return (Uint64)rng_next(stream)*n >> 32;
+}
+
+// UNIFORM IN [0, 1)
+static inline float rng_float(RngStream stream) {
+    return (rng_next(stream) >> 8)*(1.0f/16777216.0f);
+}
+
+// EVERY STREAM GETS THE SAME SEED ON ITS OWN SEQUENCE
+void seed_rngs(Uint64 seed) {
+    for (int x = 0; x < N_RNG_STREAMS; x++) {
+        RNG[x].state = 0;
+        RNG[x].inc = (Uint64)x << 1 | 1;
+        rng_next(x);
+        RNG[x].state += seed;
+        rng_next(x);
+    }
+}
+
+Uint64 clock_counter() {
+    return VIRTUAL_CLOCK ? VIRTUAL_COUNTER : SDL_GetPerformanceCounter();
+}
+
+void sim_clock_init(SimClock *C, Uint64 now) {
+    C->last = now;
+    C->acc = 0;
+    C->tick = SDL_GetPerformanceFrequency()/TICK_RATE;
+    C->alpha = 0.f;
+}
+
+// BANKS THE TIME SINCE THE LAST FRAME WHEN running, PAUSED TIME IS NEVER SIMULATED
+void sim_clock_frame(SimClock *C, Uint64 now, bool running) {
+    if (running) C->acc += now - C->last;
+    C->last = now;
+    if (C->acc > C->tick*MAX_TICKS_PER_FRAME) C->acc = C->tick*MAX_TICKS_PER_FRAME;
+}
+
+float lerp(float a, float b, float t) {
+    return a + (b - a)*t;
+}
+
+void timers_reset(TimerWheel *W) {
+    for (int x = 0; x < WHEEL_SLOTS; x++) W->slots[x] = -1;
+    W->fired = 0;
+    W->ticks = 0;
+    W->now = 0;
+    W->tick = 0;
+}
+
+void timer_schedule(TimerWheel *W, TimerId id, size_t delay) {
+    W->deadline[id] = W->now + delay;
+    int slot = W->deadline[id]/WHEEL_TICK % WHEEL_SLOTS;
+    W->next[id] = W->slots[slot];
+    W->slots[slot] = id;
+}
+
+// MOVES GAME TIME BY ONE SIMULATION TICK, THEN FIRES THE TIMERS THAT ARE DUE
+void timers_advance(TimerWheel *W) {
+    W->ticks++;
+    W->now = W->ticks*1000/TICK_RATE;
+    size_t last = W->now/WHEEL_TICK;
+    // AFTER A STALL EVERY SLOT IS VISITED ONCE, NOT ONCE PER LAP
+    if (last - W->tick > WHEEL_SLOTS) W->tick = last - WHEEL_SLOTS;
+    // THE CURRENT SLOT IS VISITED AGAIN NEXT TIME, IT CAN HOLD TIMERS DUE LATER IN THE SAME TICK
+    for (;; W->tick++) {
+        int *link = &W->slots[W->tick % WHEEL_SLOTS];
+        while (*link >= 0) {
+            int id = *link;
+            if (W->deadline[id] <= W->now) {
+                *link = W->next[id];
+                W->fired |= (Uint32)1 << id;
+            } else {
+                link = &W->next[id];
+            }
+        }
+        if (W->tick == last) break;
+    }
+}
+
+// TRUE ONCE FOR EVERY TIME id FIRED, THE TIMER IS NOT SCHEDULED AGAIN UNTIL timer_schedule
+bool timer_take(TimerWheel *W, TimerId id) {
+    bool fired = W->fired >> id & 1;
+    W->fired &= ~((Uint32)1 << id);
+    return fired;
+}
+
+// MS OF GAME TIME TO THE NEXT OCCURRENCE OF id, RANDOM INTERVALS ARE DRAWN ONCE, WHEN IT'S SCHEDULED
+size_t timer_delay(TimerId id) {
+    float speed = SPEED*(TICK_RATE/60.0f);
+    switch (id) {
+        case TIMER_BIRD_SPAWN:
+        case TIMER_CACTUS_SPAWN:
+            return (rng_below(RNG_SPAWN, 15000) + 7500)/speed;
+        case TIMER_CLOUD_SPAWN:
+            return (rng_below(RNG_SPAWN, 25000) + 5000)/speed;
+        case TIMER_DINO_STEP:
+            return 1000/speed;
+        case TIMER_BIRD_FLAP:
+            return 300;
+        case TIMER_AMMO:
+            return 3500/speed;
+        default:
+            UNREACHABLE();
+    }
+    return 0;
+}
+
+void timer_repeat(TimerWheel *W, TimerId id) {
+    timer_schedule(W, id, timer_delay(id));
+}
+
+// THE FIRST ROUND OF AMMO COMES ON THE FIRST TICK OF A GAME
+void schedule_game_timers(TimerWheel *W) {
+    for (int x = 0; x < N_TIMERS; x++) {
+        if (x != TIMER_AMMO) timer_repeat(W, x);
+    }
+    timer_schedule(W, TIMER_AMMO, 0);
+}
+
+void pacer_init(FramePacer *P, Uint64 now) {
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    P->period = freq/FPS;
+    P->deadline = now + P->period;
+    P->spin = freq*PACE_SPIN_MIN_US/1000000;
+    P->oversleep = 0;
+    P->error = 0;
+}
+
+void pacer_wait(FramePacer *P) {
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 min_spin = freq*PACE_SPIN_MIN_US/1000000;
+    Uint64 max_spin = freq*PACE_SPIN_MAX_US/1000000;
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (P->deadline > now + P->spin) {
+        Uint32 ms = (P->deadline - now - P->spin)*1000/freq;
+        if (ms > 0) {
+            SDL_Delay(ms);
+            Uint64 woke = SDL_GetPerformanceCounter();
+            Uint64 asked = ms*freq/1000;
+            Uint64 over = woke - now > asked ? woke - now - asked : 0;
+            P->oversleep = (P->oversleep*7 + over)/8;
+            // WOKE UP PAST THE DEADLINE: THE WHOLE OVERSLEEP GOES INTO THE MARGIN NOW, NOT WHEN THE AVERAGE CATCHES UP
+            if (woke > P->deadline && over > P->oversleep) P->oversleep = over;
+        }
+    }
+    P->spin = SDL_clamp(2*P->oversleep + min_spin, min_spin, max_spin);
+
+    Uint64 end;
+    while ((end = SDL_GetPerformanceCounter()) < P->deadline) SDL_CPUPauseInstruction();
+    P->error = end - P->deadline;
+    P->deadline += P->period;
+    // MORE THAN A FRAME LATE: START OVER FROM NOW INSTEAD OF RUSHING THE NEXT FRAMES TO CATCH UP
+    if (end > P->deadline) P->deadline = end + P->period;
+}
+
+SDL_Surface *load_image(const char *path) {
+    SDL_Surface *srf;
+    TRACE_ZONE(path, srf = IMG_Load(path));
+    return srf;
+}
+
+// FIRST FORMAT WITH ALPHA THE RENDERER'S TEXTURES USE, SDL_CreateTextureFromSurface PICKS THE SAME ONE
+Uint32 native_format(SDL_Renderer *renderer) {
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0) {
+        for (Uint32 x = 0; x < info.num_texture_formats; x++) {
+            Uint32 format = info.texture_formats[x];
+            if (!SDL_ISPIXELFORMAT_FOURCC(format) && SDL_ISPIXELFORMAT_ALPHA(format)) return format;
+        }
+    }
+    return SDL_PIXELFORMAT_ARGB8888;
+}
+
+// CROPS THE IMAGE TO THE DRAWN ROWS, CONVERTS IT TO format AND SCALES IT TO ITS DRAWN SIZE.
+// BIG DOWNSCALES (E.G. sight.png 796px -> 80px) ARE HALVED STEP BY STEP SO EVERY SOURCE PIXEL COUNTS
+SDL_Surface *preprocess_sprite(State *state, SDL_Surface *srf, const SpriteSource *source, Uint32 format) {
+    TRACE_BEGIN("preprocess_sprite");
+    SDL_Surface *cur = SDL_ConvertSurfaceFormat(srf, format, 0);
+    CHECK_ERROR_ptr(cur, state);
+    SDL_FreeSurface(srf);
+    if (cur == NULL) {
+        TRACE_END("preprocess_sprite");
+        return NULL;
+    }
+
+    SDL_Rect from = {.x = 0, .y = 0, .w = cur->w, .h = cur->h};
+    if (source->h && source->h < from.h) from.h = source->h;
+    int w = from.w;
+    int h = from.h;
+    while (w != source->dst_w || h != source->dst_h) {
+        w = w/2 >= source->dst_w ? w/2 : source->dst_w;
+        h = h/2 >= source->dst_h ? h/2 : source->dst_h;
+        SDL_Surface *next = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, format);
+        CHECK_ERROR_ptr(next, state);
+        if (next == NULL) break;
+        CHECK_ERROR_int(SDL_SoftStretchLinear(cur, &from, next, NULL), state);
+        SDL_FreeSurface(cur);
+        cur = next;
+        from = (SDL_Rect){.x = 0, .y = 0, .w = w, .h = h};
+    }
+    TRACE_END("preprocess_sprite");
+    return cur;
+}
+
+// SHELF PACKER: SPRITES SORTED BY HEIGHT, PLACED LEFT TO RIGHT IN ROWS ATLAS_W WIDE (OR AS WIDE AS THE WIDEST SPRITE)
+void build_sprite_atlas(SDL_Renderer *renderer, State *state, SpriteAtlas *atlas, Uint32 format) {
+    TRACE_BEGIN("build_sprite_atlas");
+    int order[N_SPRITES];
+    int atlas_w = ATLAS_W;
+    for (int x = 0; x < N_SPRITES; x++) {
+        SDL_Surface *srf = atlas->srfs[x];
+        int h = srf ? srf->h : 0;
+        atlas->rects[x] = (SDL_Rect){.x = 0, .y = 0, .w = srf ? srf->w : 0, .h = h};
+        if (atlas->rects[x].w > atlas_w) atlas_w = atlas->rects[x].w;
+
+        int y = x;
+        while (y > 0 && atlas->rects[order[y - 1]].h < h) {
+            order[y] = order[y - 1];
+            y--;
+        }
+        order[y] = x;
+    }
+
+    int pen_x = 0;
+    int pen_y = 0;
+    int shelf_h = 0;
+    for (int x = 0; x < N_SPRITES; x++) {
+        SDL_Rect *r = &atlas->rects[order[x]];
+        if (pen_x + r->w > atlas_w) {
+            pen_x = 0;
+            pen_y += shelf_h + ATLAS_PADDING;
+            shelf_h = 0;
+        }
+        r->x = pen_x;
+        r->y = pen_y;
+        pen_x += r->w + ATLAS_PADDING;
+        if (r->h > shelf_h) shelf_h = r->h;
+    }
+
+    SDL_Surface *srf = SDL_CreateRGBSurfaceWithFormat(0, atlas_w, pen_y + shelf_h, 32, format);
+    CHECK_ERROR_ptr(srf, state);
+    if (srf == NULL) return;
+    for (int x = 0; x < N_SPRITES; x++) {
+        if (atlas->srfs[x] == NULL) continue;
+        SDL_Rect from = {.x = 0, .y = 0, .w = atlas->rects[x].w, .h = atlas->rects[x].h};
+        SDL_Rect to = atlas->rects[x];
+        SDL_BlendMode mode;
+        SDL_GetSurfaceBlendMode(atlas->srfs[x], &mode);
+        SDL_SetSurfaceBlendMode(atlas->srfs[x], SDL_BLENDMODE_NONE);
+        CHECK_ERROR_int(SDL_BlitSurface(atlas->srfs[x], &from, srf, &to), state);
+        SDL_SetSurfaceBlendMode(atlas->srfs[x], mode);
     }
+    atlas->txt = SDL_CreateTextureFromSurface(renderer, srf);
+    CHECK_ERROR_ptr(atlas->txt, state);
+    SDL_FreeSurface(srf);
+    TRACE_END("build_sprite_atlas");
+}
 
+void build_collision_mask(SDL_Surface *srf, CollisionMask *mask) {
+    memset(mask, 0, sizeof(*mask));
+    if (srf == NULL || srf->format->BytesPerPixel != 4) return;
+    mask->w = srf->w;
+    mask->h = srf->h;
+    mask->words = (srf->w + 63)/64;
+    mask->bits = (Uint64*)calloc(mask->words*mask->h, sizeof(Uint64));
+    SDL_LockSurface(srf);
+    for (int y = 0; y < srf->h; y++) {
+        const Uint32 *row = (const Uint32*)((const Uint8*)srf->pixels + y*srf->pitch);
+        Uint64 *bits = &mask->bits[y*mask->words];
+        for (int x = 0; x < srf->w; x++) {
+            Uint8 r, g, b, a;
+            SDL_GetRGBA(row[x], srf->format, &r, &g, &b, &a);
+            if (a >= MASK_ALPHA) bits[x/64] |= (Uint64)1 << (x%64);
+        }
+    }
+    SDL_UnlockSurface(srf);
+}
 
-#define DA_UNINIT_CASE(TYPE, MEMBER)                                \
-    case TYPE:                                                      \
-    for (size_t x = 0; x < DA->ptr.MEMBER->size; x++) {             \
-        if (DA->ptr.MEMBER->data[x]) free(DA->ptr.MEMBER->data[x]); \
-    }                                                               \
-    free(DA->ptr.MEMBER);                                           \
-    break;                                                          \
+void build_collision_masks(SpriteAtlas *atlas) {
+    TRACE_BEGIN("build_collision_masks");
+    for (int x = 0; x < N_SPRITES; x++) build_collision_mask(atlas->srfs[x], &atlas->masks[x]);
+    TRACE_END("build_collision_masks");
+}
 
+void destroy_collision_masks(SpriteAtlas *atlas) {
+    for (int x = 0; x < N_SPRITES; x++) {
+        if (atlas->masks[x].bits) free(atlas->masks[x].bits);
+        memset(&atlas->masks[x], 0, sizeof(CollisionMask));
+    }
+}
 
-#define DA_APPEND_CASE(TYPE, MEMBER)                                                                                                                              \
-    case TYPE:                                                                                                                                                    \
-        if (DA->ptr.MEMBER->count == DA->ptr.MEMBER->size - 1) {                                                                                                  \
-            DA->ptr.MEMBER->data = (typeof(DA->ptr.MEMBER->data))realloc(DA->ptr.MEMBER->data, sizeof(typeof(*DA->ptr.MEMBER->data)) * DA->ptr.MEMBER->size * 2); \
-            memset(DA->ptr.MEMBER->data + DA->ptr.MEMBER->size, 0, sizeof(typeof(*DA->ptr.MEMBER->data)) * DA->ptr.MEMBER->size);                                 \
-            DA->ptr.MEMBER->size *= 2;                                                                                                                            \
-        }                                                                                                                                                         \
-        for (size_t x = 0; x < DA->ptr.MEMBER->size; x++) {                                                                                                       \
-            if (DA->ptr.MEMBER->data[x] == NULL) {                                                                                                                \
-                DA->ptr.MEMBER->data[x] = (typeof(*DA->ptr.MEMBER->data))ent;                                                                                     \
-                DA->ptr.MEMBER->count++;                                                                                                                          \
-                return;                                                                                                                                           \
-            }                                                                                                                                                     \
-        }                                                                                                                                                         \
-        break;                                                                                                                                                    \
+// 64 PIXELS OF A MASK ROW STARTING AT PIXEL bit, 0 PAST THE END OF THE ROW
+Uint64 mask_row_bits(const Uint64 *row, int words, int bit) {
+    int w = bit/64;
+    int s = bit%64;
+    Uint64 v = w < words ? row[w] >> s : 0;
+    if (s && w + 1 < words) v |= row[w + 1] << (64 - s);
+    return v;
+}
 
+bool mask_pixel(const CollisionMask *m, int x, int y) {
+    if (x < 0 || y < 0 || x >= m->w || y >= m->h) return false;
+    return m->bits[y*m->words + x/64] >> (x%64) & 1;
+}
 
-void cap_fps(size_t t1, size_t t2) {
-    size_t frametime = 1000/(FPS);
-    if (t2 - t1 < frametime) {
-        SDL_Delay(frametime - (t2 - t1));
+// RECTANGLES FIRST, THEN THE OVERLAPPING ROWS OF THE TWO MASKS ANDED 64 PIXELS AT A TIME.
+// NO TAIL MASK: PAST THE RIGHT END OF THE OVERLAP ONE OF THE TWO ROWS IS ALREADY ALL 0
+bool masks_overlap(const CollisionMask *a, int ax, int ay, const CollisionMask *b, int bx, int by) {
+    int x0 = SDL_max(ax, bx);
+    int x1 = SDL_min(ax + a->w, bx + b->w);
+    int y0 = SDL_max(ay, by);
+    int y1 = SDL_min(ay + a->h, by + b->h);
+    if (x0 >= x1 || y0 >= y1) return false;
+    if (a->bits == NULL || b->bits == NULL) return true;
+    for (int y = y0; y < y1; y++) {
+        const Uint64 *ra = &a->bits[(y - ay)*a->words];
+        const Uint64 *rb = &b->bits[(y - by)*b->words];
+        for (int x = x0; x < x1; x += 64) {
+            if (mask_row_bits(ra, a->words, x - ax) & mask_row_bits(rb, b->words, x - bx)) return true;
+        }
     }
+    return false;
+}
+
+void set_sprite(Assets *A, Asset *a, SpriteId sprite) {
+    a->sprite = sprite;
+    a->src = A->Atlas.rects[sprite];
+    a->srf = A->Atlas.srfs[sprite];
+    a->txt = A->Atlas.txt;
 }
 
-void init_assets(SDL_Renderer *renderer, Assets* A) {
+void init_assets(SDL_Renderer *renderer, State *state, Assets* A) {
+    TRACE_BEGIN("init_assets");
+    Uint32 format = native_format(renderer);
+    for (int x = 0; x < N_SPRITES; x++) {
+        A->Atlas.srfs[x] = load_image(SPRITE_SOURCES[x].path);
+        CHECK_ERROR_ptr(A->Atlas.srfs[x], state);
+        if (A->Atlas.srfs[x]) A->Atlas.srfs[x] = preprocess_sprite(state, A->Atlas.srfs[x], &SPRITE_SOURCES[x], format);
+    }
+    build_sprite_atlas(renderer, state, &A->Atlas, format);
+    build_collision_masks(&A->Atlas);
+
     A->Back_1 = (Asset*)malloc(sizeof(Asset));
-    A->Back_1->src = (SDL_Rect){.x=0, .y=0, .h=60, .w=WINDOW_WIDTH};
     A->Back_1->dst = (SDL_FRect){.x=0.f, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y, .h=SOIL_HEIGHT, .w=WINDOW_WIDTH};
-    A->Back_1->srf = IMG_Load("./assets/img/back_1.png");
-    A->Back_1->txt = SDL_CreateTextureFromSurface(renderer, A->Back_1->srf);
+    A->Back_1->prev_x = A->Back_1->dst.x;
+    set_sprite(A, A->Back_1, SPRITE_BACK_1);
 
     A->Back_2 = (Asset*)malloc(sizeof(Asset));
-    A->Back_2->src = (SDL_Rect){.x=0, .y=0, .h=60, .w=WINDOW_WIDTH};
     A->Back_2->dst = (SDL_FRect){.x=WINDOW_WIDTH, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y, .h=SOIL_HEIGHT, .w=WINDOW_WIDTH};
-    A->Back_2->srf = IMG_Load("./assets/img/back_2.png");
-    A->Back_2->txt = SDL_CreateTextureFromSurface(renderer, A->Back_2->srf);
-
-
-    // NO NEED FOR dst SINCE IT IS USED FOR TEXTURE
-    A->Back_3 = (Asset*)malloc(sizeof(Asset));
-    A->Back_3->src = (SDL_Rect){.x=0, .y=0, .h=60, .w=WINDOW_WIDTH};
-    A->Back_3->srf = IMG_Load("./assets/img/back_3.png");
-    A->Back_3->txt = SDL_CreateTextureFromSurface(renderer, A->Back_3->srf);
-    A->Backs[0] = A->Back_1->txt;
-    A->Backs[1] = A->Back_2->txt;
-    A->Backs[2] = A->Back_3->txt;
+    A->Back_2->prev_x = A->Back_2->dst.x;
+    set_sprite(A, A->Back_2, SPRITE_BACK_2);
 
     A->Dino = (Asset*)malloc(sizeof(Asset));
-    A->Dino->src = (SDL_Rect){.x=0, .y=0, .h=286, .w=232};
     A->Dino->dst = (SDL_FRect){.x=WINDOW_WIDTH/10, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - DINO_H*5/6, .h=DINO_H, .w=DINO_W};
-    A->Dino->srf = IMG_Load("./assets/img/dino_l.png");
-    A->Dinos_srf = IMG_Load("./assets/img/dino_r.png");
-    A->Dino->txt = SDL_CreateTextureFromSurface(renderer, A->Dino->srf);
-    A->Dinos_txt = SDL_CreateTextureFromSurface(renderer, A->Dinos_srf);
+    set_sprite(A, A->Dino, SPRITE_DINO_L);
 
     A->Gun = (Asset*)malloc(sizeof(Asset));
-    A->Gun->src = (SDL_Rect){.x=0, .y=0, .h=388, .w=750};
     A->Gun->dst = (SDL_FRect){.x=WINDOW_WIDTH/10 + DINO_W*35/48, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - DINO_H*0.4, .h=GUN_H, .w=GUN_W};
-    A->Gun->srf = IMG_Load("./assets/img/gun.png");
-    A->Gun->txt = SDL_CreateTextureFromSurface(renderer, A->Gun->srf);
+    set_sprite(A, A->Gun, SPRITE_GUN);
 
     A->Gsight = (Asset*)malloc(sizeof(Asset));
-    A->Gsight->src = (SDL_Rect){.x=0, .y=0, .h=796, .w=796};
     A->Gsight->dst = (SDL_FRect){.x=0, .y=0, .h=GSIGHT_H, .w=GSIGHT_W};
-    A->Gsight->srf = IMG_Load("./assets/img/sight.png");
-    A->Gsight->txt = SDL_CreateTextureFromSurface(renderer, A->Gsight->srf);
+    set_sprite(A, A->Gsight, SPRITE_GSIGHT);
 
     A->Bird_Down = (Asset*)malloc(sizeof(Asset));
-    A->Bird_Down->src = (SDL_Rect){.x=0, .y=0, .h=55, .w=98};
     A->Bird_Down->dst = (SDL_FRect){.x=WINDOW_WIDTH + 100, .y=WINDOW_HEIGHT/2, .h=BIRD_H, .w=BIRD_W};
-    A->Bird_Down->srf = IMG_Load("./assets/img/bird_down.png");
-    A->Bird_Down->txt = SDL_CreateTextureFromSurface(renderer, A->Bird_Down->srf);
+    set_sprite(A, A->Bird_Down, SPRITE_BIRD_DOWN);
 
     A->Bird_Up = (Asset*)malloc(sizeof(Asset));
-    A->Bird_Up->src = (SDL_Rect){.x=0, .y=0, .h=55, .w=98};
     A->Bird_Up->dst = (SDL_FRect){.x=WINDOW_WIDTH + 100, .y=WINDOW_HEIGHT/2, .h=BIRD_H, .w=BIRD_W};
-    A->Bird_Up->srf = IMG_Load("./assets/img/bird_up.png");
-    A->Bird_Up->txt = SDL_CreateTextureFromSurface(renderer, A->Bird_Up->srf);
+    set_sprite(A, A->Bird_Up, SPRITE_BIRD_UP);
 
     A->Cactus_1 = (Asset*)malloc(sizeof(Asset));
-    A->Cactus_1->src = (SDL_Rect){.x=0, .y=0, .h=100, .w=51};
     A->Cactus_1->dst = (SDL_FRect){.x=WINDOW_WIDTH + 150, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - CACTUS_H*0.5, .h=CACTUS_H, .w=CACTUS_1W};
-    A->Cactus_1->srf = IMG_Load("./assets/img/cactus_1.png");
-    A->Cactus_1->txt = SDL_CreateTextureFromSurface(renderer, A->Cactus_1->srf);
+    set_sprite(A, A->Cactus_1, SPRITE_CACTUS_1);
 
     A->Cactus_2 = (Asset*)malloc(sizeof(Asset));
-    A->Cactus_2->src = (SDL_Rect){.x=0, .y=0, .h=100, .w=98};
     A->Cactus_2->dst = (SDL_FRect){.x=WINDOW_WIDTH + 150, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - CACTUS_H*0.5, .h=CACTUS_H, .w=CACTUS_2W};
-    A->Cactus_2->srf = IMG_Load("./assets/img/cactus_2.png");
-    A->Cactus_2->txt = SDL_CreateTextureFromSurface(renderer, A->Cactus_2->srf);
+    set_sprite(A, A->Cactus_2, SPRITE_CACTUS_2);
 
     A->Cactus_3 = (Asset*)malloc(sizeof(Asset));
-    A->Cactus_3->src = (SDL_Rect){.x=0, .y=0, .h=100, .w=103};
     A->Cactus_3->dst = (SDL_FRect){.x=WINDOW_WIDTH + 150, .y=WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - CACTUS_H*0.5, .h=CACTUS_H, .w=CACTUS_3W};
-    A->Cactus_3->srf = IMG_Load("./assets/img/cactus_3.png");
-    A->Cactus_3->txt = SDL_CreateTextureFromSurface(renderer, A->Cactus_3->srf);
+    set_sprite(A, A->Cactus_3, SPRITE_CACTUS_3);
 
     A->Cloud = (Asset*)malloc(sizeof(Asset));
-    A->Cloud->src = (SDL_Rect){.x=0, .y=0, .h=37, .w=83};
     A->Cloud->dst = (SDL_FRect){.x=WINDOW_WIDTH + 150, .y=WINDOW_HEIGHT/2, .h=CLOUD_H, .w=CLOUD_W};
-    A->Cloud->srf = IMG_Load("./assets/img/cloud.png");
-    A->Cloud->txt = SDL_CreateTextureFromSurface(renderer, A->Cloud->srf);
+    set_sprite(A, A->Cloud, SPRITE_CLOUD);
 
     A->Bullet = (AssetRot*)malloc(sizeof(AssetRot));
-    A->Bullet->src = (SDL_Rect){.x=0, .y=0, .h=20.f, .w=48};
+    A->Bullet->src = A->Atlas.rects[SPRITE_BULLET];
     A->Bullet->dst = (SDL_FRect){.x=0.f, .y=0.f, .h=BULLET_H, .w=BULLET_W};
     A->Bullet->angle = 0.0f;
     A->Bullet->rot_c = (SDL_FPoint) {.x = 0, .y = 0};
-    A->Bullet->srf = IMG_Load("./assets/img/bullet.png");
-    A->Bullet->txt = SDL_CreateTextureFromSurface(renderer, A->Bullet->srf);
+    A->Bullet->srf = A->Atlas.srfs[SPRITE_BULLET];
+    A->Bullet->txt = A->Atlas.txt;
     
     A->Vol = (Asset*)malloc(sizeof(Asset));
-    A->Vol->src = (SDL_Rect){.x=0, .y=0, .h=512, .w=512};
     A->Vol->dst = (SDL_FRect){.x=WINDOW_WIDTH/2 - VOLUME_W/2, .y = FACTOR*10/100, .h=VOLUME_H, .w=VOLUME_W};
-    A->Vol->srf = IMG_Load("./assets/img/vol_max.png");
-    A->Vol->txt = SDL_CreateTextureFromSurface(renderer, A->Vol->srf);
-    
-    // NO NEED FOR dst SINCE IT IS USED FOR TEXTURE
-    A->Volume_max = (Asset*)malloc(sizeof(Asset));
-    A->Volume_max->src = A->Vol->src;
-    A->Volume_max->srf = A->Vol->srf;
-    A->Volume_max->txt = A->Vol->txt;
-
-    // NO NEED FOR dst SINCE IT IS USED FOR TEXTURE
-    A->Volume_mid = (Asset*)malloc(sizeof(Asset));
-    A->Volume_mid->src = A->Vol->src;
-    A->Volume_mid->srf = IMG_Load("./assets/img/vol_mid.png");
-    A->Volume_mid->txt = SDL_CreateTextureFromSurface(renderer, A->Volume_mid->srf);
-    
-    // NO NEED FOR dst SINCE IT IS USED FOR TEXTURE
-    A->Volume_low = (Asset*)malloc(sizeof(Asset));
-    A->Volume_low->src = A->Vol->src;
-    A->Volume_low->srf = IMG_Load("./assets/img/vol_low.png");
-    A->Volume_low->txt = SDL_CreateTextureFromSurface(renderer, A->Volume_low->srf);
-
-    // NO NEED FOR dst SINCE IT IS USED FOR TEXTURE
-    A->Volume_zero = (Asset*)malloc(sizeof(Asset));
-    A->Volume_zero->src = A->Vol->src;
-    A->Volume_zero->srf = IMG_Load("./assets/img/vol_zero.png");
-    A->Volume_zero->txt = SDL_CreateTextureFromSurface(renderer, A->Volume_zero->srf);
-
+    set_sprite(A, A->Vol, SPRITE_VOL_MAX);
+    TRACE_END("init_assets");
 }
 
 void destroy_assets(Assets *A) {
-    #define N_ASSETS 17
+    #define N_ASSETS 12
 
     Asset *arrayOfAssets[N_ASSETS] = {A->Dino,
                                 A->Gun,
                                 A->Gsight,
                                 A->Back_1,
                                 A->Back_2,
-                                A->Back_3,
                                 A->Bird_Down,
                                 A->Bird_Up,
                                 A->Cactus_1,
                                 A->Cactus_2,
                                 A->Cactus_3,
                                 A->Cloud,
-                                A->Volume_max,
-                                A->Volume_mid,
-                                A->Volume_low,
-                                A->Volume_zero,
                                 A->Vol,
                             };
+    // SURFACES AND TEXTURE ARE OWNED BY THE ATLAS
     for (int x = 0; x < N_ASSETS; x++) {
-        Asset *ptr = arrayOfAssets[x];
-        if (ptr && ptr->srf) SDL_FreeSurface(ptr->srf);
-        if (ptr && ptr->txt) SDL_DestroyTexture(ptr->txt);
-        if (ptr) free(ptr);
+        if (arrayOfAssets[x]) free(arrayOfAssets[x]);
     }
+    if (A->Bullet) free(A->Bullet);
 
-    if (A->Backs[0]) SDL_DestroyTexture(A->Backs[0]);
-    if (A->Backs[1]) SDL_DestroyTexture(A->Backs[1]);
-    if (A->Backs[2]) SDL_DestroyTexture(A->Backs[2]);
-    if (A->Dinos_txt) SDL_DestroyTexture(A->Dinos_txt);
-    if (A->Dinos_srf) SDL_FreeSurface(A->Dinos_srf);
+    for (int x = 0; x < N_SPRITES; x++) {
+        if (A->Atlas.srfs[x]) SDL_FreeSurface(A->Atlas.srfs[x]);
+    }
+    if (A->Atlas.txt) SDL_DestroyTexture(A->Atlas.txt);
+    destroy_collision_masks(&A->Atlas);
+    for (int x = 0; x < N_SPRITES; x++) {
+        if (A->Rotations.frames[x]) free(A->Rotations.frames[x]);
+    }
+    if (A->Rotations.txt) SDL_DestroyTexture(A->Rotations.txt);
+}
 
+// BILINEAR SAMPLE OF A PREMULTIPLIED RGBA32 COPY OF THE SPRITE, TRANSPARENT OUTSIDE OF IT
+void sample_premultiplied(SDL_Surface *srf, float x, float y, float out[4]) {
+    int x0 = SDL_floorf(x);
+    int y0 = SDL_floorf(y);
+    float fx = x - x0;
+    float fy = y - y0;
+    float weights[4] = {(1 - fx)*(1 - fy), fx*(1 - fy), (1 - fx)*fy, fx*fy};
+    int xs[4] = {x0, x0 + 1, x0, x0 + 1};
+    int ys[4] = {y0, y0, y0 + 1, y0 + 1};
+    out[0] = out[1] = out[2] = out[3] = 0;
+    for (int k = 0; k < 4; k++) {
+        if (xs[k] < 0 || ys[k] < 0 || xs[k] >= srf->w || ys[k] >= srf->h) continue;
+        const Uint8 *p = (const Uint8*)srf->pixels + ys[k]*srf->pitch + xs[k]*4;
+        for (int c = 0; c < 4; c++) out[c] += p[c]*weights[k];
+    }
 }
 
-void init_DA(DA *DA){
-    DA_INIT_CASE(DA_TYPE_ENTITIES, DAe)
-    DA_INIT_CASE(DA_TYPE_BULLETS, DAb)
-    DA_INIT_CASE(DA_TYPE_PARTICLES, DAp)
-    DA_INIT_CASE(DA_TYPE_CLUSTERS, DApc)
-    UNREACHABLE()
+// PRE-ROTATES THE GUN AND THE BULLET AT steps ANGLES IN ONE TEXTURE, DRAWING THEM IS THEN A PLAIN COPY OF THE NEAREST FRAME
+void build_rotation_cache(SDL_Renderer *renderer, State *state, Assets *A, int steps) {
+    RotationCache *cache = &A->Rotations;
+    memset(cache, 0, sizeof(*cache));
+    cache->steps = steps;
+    if (steps <= 0) return;
+    TRACE_BEGIN("build_rotation_cache");
+
+    #define N_ROTATED 2
+    SpriteId rotated[N_ROTATED] = {SPRITE_GUN, SPRITE_BULLET};
+    SDL_Surface *sources[N_ROTATED] = {0};
+
+    // FRAME SIZES FIRST, PACKED IN SHELVES LIKE THE SPRITE ATLAS
+    int pen_x = 0;
+    int pen_y = 0;
+    int shelf_h = 0;
+    for (int r = 0; r < N_ROTATED; r++) {
+        SDL_Surface *srf = A->Atlas.srfs[rotated[r]];
+        if (srf == NULL) continue;
+        sources[r] = SDL_ConvertSurfaceFormat(srf, SDL_PIXELFORMAT_RGBA32, 0);
+        CHECK_ERROR_ptr(sources[r], state);
+        if (sources[r] == NULL) continue;
+        SDL_Surface *src = sources[r];
+        Uint8 *px = (Uint8*)src->pixels;
+        for (int y = 0; y < src->h; y++) {
+            for (int x = 0; x < src->w; x++) {
+                Uint8 *p = px + y*src->pitch + x*4;
+                p[0] = p[0]*p[3]/255;
+                p[1] = p[1]*p[3]/255;
+                p[2] = p[2]*p[3]/255;
+            }
+        }
+
+        cache->frames[rotated[r]] = (SDL_Rect*)malloc(sizeof(SDL_Rect)*steps);
+        for (int k = 0; k < steps; k++) {
+            float rad = 2*PI*k/steps;
+            float c = SDL_fabsf(cosf(rad));
+            float s = SDL_fabsf(sinf(rad));
+            SDL_Rect *f = &cache->frames[rotated[r]][k];
+            // ONE TRANSPARENT PIXEL AROUND THE ROTATED SPRITE FOR THE BILINEAR EDGE
+            f->w = SDL_ceilf(src->w*c + src->h*s) + 2;
+            f->h = SDL_ceilf(src->w*s + src->h*c) + 2;
+            if (pen_x + f->w > ATLAS_W) {
+                pen_x = 0;
+                pen_y += shelf_h + ATLAS_PADDING;
+                shelf_h = 0;
+            }
+            f->x = pen_x;
+            f->y = pen_y;
+            pen_x += f->w + ATLAS_PADDING;
+            if (f->h > shelf_h) shelf_h = f->h;
+        }
+    }
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_W, pen_y + shelf_h, 32, SDL_PIXELFORMAT_RGBA32);
+    CHECK_ERROR_ptr(atlas, state);
+    for (int r = 0; r < N_ROTATED && atlas; r++) {
+        SDL_Surface *src = sources[r];
+        if (src == NULL) continue;
+        for (int k = 0; k < steps; k++) {
+            SDL_Rect *f = &cache->frames[rotated[r]][k];
+            float rad = 2*PI*k/steps;
+            float c = cosf(rad);
+            float s = sinf(rad);
+            for (int v = 0; v < f->h; v++) {
+                Uint8 *row = (Uint8*)atlas->pixels + (f->y + v)*atlas->pitch + f->x*4;
+                for (int u = 0; u < f->w; u++) {
+                    // INVERSE ROTATION OF THE PIXEL CENTER AROUND THE FRAME CENTER, BACK INTO THE SPRITE
+                    float dx = u + 0.5f - f->w/2.0f;
+                    float dy = v + 0.5f - f->h/2.0f;
+                    float sx = dx*c + dy*s + src->w/2.0f - 0.5f;
+                    float sy = -dx*s + dy*c + src->h/2.0f - 0.5f;
+                    float rgba[4];
+                    sample_premultiplied(src, sx, sy, rgba);
+                    Uint8 *p = row + u*4;
+                    p[3] = rgba[3] + 0.5f;
+                    for (int ch = 0; ch < 3; ch++) {
+                        float unpremultiplied = rgba[3] > 0 ? rgba[ch]*255/rgba[3] : 0;
+                        p[ch] = unpremultiplied > 255 ? 255 : unpremultiplied + 0.5f;
+                    }
+                }
+            }
+        }
+    }
+    for (int r = 0; r < N_ROTATED; r++) {
+        if (sources[r]) SDL_FreeSurface(sources[r]);
+    }
+    if (atlas) {
+        cache->txt = SDL_CreateTextureFromSurface(renderer, atlas);
+        CHECK_ERROR_ptr(cache->txt, state);
+        LOG("Rotation cache: %d steps, %dx%d texture", steps, atlas->w, atlas->h);
+        SDL_FreeSurface(atlas);
+    }
+    TRACE_END("build_rotation_cache");
 }
 
-void uninit_DA(DA *DA) {
-    switch(DA->type) {
-        DA_UNINIT_CASE(DA_TYPE_ENTITIES, DAe)
-        DA_UNINIT_CASE(DA_TYPE_BULLETS, DAb)
-        DA_UNINIT_CASE(DA_TYPE_PARTICLES, DAp)
-        DA_UNINIT_CASE(DA_TYPE_CLUSTERS, DApc)
-        default:
-            UNREACHABLE()
-            break;
+int compare_u64(const void *a, const void *b) {
+    Uint64 x = *(const Uint64*)a;
+    Uint64 y = *(const Uint64*)b;
+    return (x > y) - (x < y);
+}
+
+void batch_reserve(int quads) {
+    if (quads <= BATCH.cap_quads) return;
+    int cap = BATCH.cap_quads ? BATCH.cap_quads : BATCH_START_QUADS;
+    while (cap < quads) cap *= 2;
+    BATCH.vertices = (SDL_Vertex*)realloc(BATCH.vertices, sizeof(SDL_Vertex)*cap*4);
+    BATCH.bounds = (SDL_FRect*)realloc(BATCH.bounds, sizeof(SDL_FRect)*cap);
+    BATCH.keys = (Uint64*)realloc(BATCH.keys, sizeof(Uint64)*cap);
+    BATCH.indices = (int*)realloc(BATCH.indices, sizeof(int)*cap*6);
+    BATCH.prev_keys = (Uint64*)realloc(BATCH.prev_keys, sizeof(Uint64)*cap);
+    BATCH.prev_bounds = (SDL_FRect*)realloc(BATCH.prev_bounds, sizeof(SDL_FRect)*cap);
+    BATCH.sorted_keys = (Uint64*)realloc(BATCH.sorted_keys, sizeof(Uint64)*cap);
+    BATCH.scratch_indices = (int*)realloc(BATCH.scratch_indices, sizeof(int)*cap*6);
+    BATCH.scratch_rects = (SDL_FRect*)realloc(BATCH.scratch_rects, sizeof(SDL_FRect)*cap);
+    for (int x = BATCH.cap_quads; x < cap; x++) {
+        int *i = &BATCH.indices[x*6];
+        i[0] = x*4;
+        i[1] = x*4 + 1;
+        i[2] = x*4 + 2;
+        i[3] = x*4;
+        i[4] = x*4 + 2;
+        i[5] = x*4 + 3;
     }
+    BATCH.cap_quads = cap;
 }
 
-void DA_append(DA *DA, void *ent) {
-    switch (DA->type) {
-        DA_APPEND_CASE(DA_TYPE_ENTITIES, DAe)
-        DA_APPEND_CASE(DA_TYPE_BULLETS, DAb)
-        DA_APPEND_CASE(DA_TYPE_PARTICLES, DAp)
-        DA_APPEND_CASE(DA_TYPE_CLUSTERS, DApc)
-        default:
-            UNREACHABLE()
-            break;
+void init_batch(SDL_Renderer *renderer, SDL_Window *window, bool dirty) {
+    memset(&BATCH, 0, sizeof(BATCH));
+    BATCH.renderer = renderer;
+    BATCH.window = window;
+    BATCH.DIRTY = dirty;
+    BATCH.FULL_REDRAW = true;
+    batch_reserve(BATCH_START_QUADS);
+}
+
+void uninit_batch() {
+    free(BATCH.vertices);
+    free(BATCH.bounds);
+    free(BATCH.keys);
+    free(BATCH.indices);
+    free(BATCH.runs);
+    free(BATCH.prev_keys);
+    free(BATCH.prev_bounds);
+    free(BATCH.sorted_keys);
+    free(BATCH.scratch_indices);
+    free(BATCH.scratch_rects);
+    memset(&BATCH, 0, sizeof(BATCH));
+}
+
+// RETURNS THE QUAD TO FILL, IN A RUN OF txt/color
+SDL_Vertex *batch_push(State *state, SDL_Texture *txt, SDL_Color color) {
+    BatchRun *run = BATCH.n_runs ? &BATCH.runs[BATCH.n_runs - 1] : NULL;
+    bool same = run && run->txt == txt && (txt || (run->color.r == color.r && run->color.g == color.g && run->color.b == color.b && run->color.a == color.a));
+    if (!same) {
+        if (BATCH.n_runs == BATCH.cap_runs) {
+            BATCH.cap_runs = BATCH.cap_runs ? BATCH.cap_runs*2 : 16;
+            BATCH.runs = (BatchRun*)realloc(BATCH.runs, sizeof(BatchRun)*BATCH.cap_runs);
+        }
+        run = &BATCH.runs[BATCH.n_runs++];
+        *run = (BatchRun){.txt = txt, .color = color, .first = BATCH.n_quads, .count = 0};
+        if (txt) {
+            int w;
+            int h;
+            CHECK_ERROR_int(SDL_QueryTexture(txt, NULL, NULL, &w, &h), state);
+            BATCH.txt_w = w;
+            BATCH.txt_h = h;
+        }
     }
-    
-}        
-
-void free_particles(DArrayOfParticlesCLusters *DApc) {
-    for (size_t x = 0; x < DApc->size; x++) {
-        DArrayOfParticles *ap = DApc->data[x];
-        if (ap != NULL) {
-            for (size_t y = 0; y < ap->size; y++) {
-                Particle *p = ap->data[y]; 
-                if (p != NULL) {
-                    free(p);
-                    p = NULL;
+    batch_reserve(BATCH.n_quads + 1);
+    run->count++;
+    return &BATCH.vertices[BATCH.n_quads++*4];
+}
+
+void batch_close_quad(SDL_Texture *txt) {
+    int q = BATCH.n_quads - 1;
+    SDL_Vertex *v = &BATCH.vertices[q*4];
+    float x0 = v[0].position.x;
+    float y0 = v[0].position.y;
+    float x1 = x0;
+    float y1 = y0;
+    for (int x = 1; x < 4; x++) {
+        if (v[x].position.x < x0) x0 = v[x].position.x;
+        if (v[x].position.x > x1) x1 = v[x].position.x;
+        if (v[x].position.y < y0) y0 = v[x].position.y;
+        if (v[x].position.y > y1) y1 = v[x].position.y;
+    }
+    BATCH.bounds[q] = (SDL_FRect){.x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0};
+    if (!BATCH.DIRTY) return;
+
+    // FNV-1a OVER THE VERTICES AND THE TEXTURE: SAME KEY == SAME PIXELS AS LAST FRAME
+    Uint64 hash = 14695981039346656037ULL;
+    const Uint8 *bytes = (const Uint8*)v;
+    for (size_t x = 0; x < sizeof(SDL_Vertex)*4; x++) hash = (hash ^ bytes[x])*1099511628211ULL;
+    hash ^= (Uint64)(uintptr_t)txt;
+    BATCH.keys[q] = hash*1099511628211ULL;
+}
+
+// QUEUES src (NULL == WHOLE TEXTURE) OF txt DRAWN OVER dst ROTATED BY angle DEGREES AROUND center (RELATIVE TO dst), LIKE SDL_RenderCopyExF
+void batch_copy_ex(State *state, SDL_Texture *txt, const SDL_Rect *src, const SDL_FRect *dst, double angle, const SDL_FPoint *center) {
+    if (txt == NULL) return;
+    SDL_Vertex *v = batch_push(state, txt, (SDL_Color){255, 255, 255, 255});
+
+    float u0 = src ? src->x/BATCH.txt_w : 0;
+    float v0 = src ? src->y/BATCH.txt_h : 0;
+    float u1 = src ? (src->x + src->w)/BATCH.txt_w : 1;
+    float v1 = src ? (src->y + src->h)/BATCH.txt_h : 1;
+    SDL_FPoint corners[4] = {
+        {.x = 0, .y = 0},
+        {.x = dst->w, .y = 0},
+        {.x = dst->w, .y = dst->h},
+        {.x = 0, .y = dst->h},
+    };
+    SDL_FPoint uvs[4] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+
+    if (angle != 0.0) {
+        float rad = angle*PI/180;
+        float c = cosf(rad);
+        float s = sinf(rad);
+        for (int x = 0; x < 4; x++) {
+            float px = corners[x].x - center->x;
+            float py = corners[x].y - center->y;
+            v[x].position.x = dst->x + center->x + px*c - py*s;
+            v[x].position.y = dst->y + center->y + px*s + py*c;
+        }
+    } else {
+        for (int x = 0; x < 4; x++) {
+            v[x].position.x = dst->x + corners[x].x;
+            v[x].position.y = dst->y + corners[x].y;
+        }
+    }
+    for (int x = 0; x < 4; x++) {
+        v[x].color = (SDL_Color){255, 255, 255, 255};
+        v[x].tex_coord = uvs[x];
+    }
+    batch_close_quad(txt);
+}
+
+void batch_copy(State *state, SDL_Texture *txt, const SDL_Rect *src, const SDL_FRect *dst) {
+    batch_copy_ex(state, txt, src, dst, 0.0, NULL);
+}
+
+// LIKE batch_copy_ex, BUT A SPRITE IN THE ROTATION CACHE IS COPIED FROM THE FRAME NEAREST TO angle
+void batch_copy_rotated(State *state, Assets *A, SpriteId sprite, const SDL_Rect *src, const SDL_FRect *dst, double angle, const SDL_FPoint *center) {
+    RotationCache *cache = &A->Rotations;
+    if (cache->txt == NULL || cache->frames[sprite] == NULL) {
+        batch_copy_ex(state, A->Atlas.txt, src, dst, angle, center);
+        return;
+    }
+    int k = (int)SDL_floor(angle/360*cache->steps + 0.5) % cache->steps;
+    if (k < 0) k += cache->steps;
+    SDL_Rect *f = &cache->frames[sprite][k];
+
+    // WHERE THE SPRITE'S CENTER ENDS UP AFTER ROTATING dst AROUND center
+    float rad = angle*PI/180;
+    float c = cosf(rad);
+    float s = sinf(rad);
+    float px = dst->w/2 - center->x;
+    float py = dst->h/2 - center->y;
+    float cx = dst->x + center->x + px*c - py*s;
+    float cy = dst->y + center->y + px*s + py*c;
+    SDL_FRect to = {.x = cx - f->w/2.0f, .y = cy - f->h/2.0f, .w = f->w, .h = f->h};
+    batch_copy(state, cache->txt, f, &to);
+}
+
+void batch_fill(State *state, const SDL_FRect *r, SDL_Color color) {
+    SDL_Vertex *v = batch_push(state, NULL, color);
+    SDL_FPoint corners[4] = {
+        {.x = r->x, .y = r->y},
+        {.x = r->x + r->w, .y = r->y},
+        {.x = r->x + r->w, .y = r->y + r->h},
+        {.x = r->x, .y = r->y + r->h},
+    };
+    for (int x = 0; x < 4; x++) {
+        v[x].position = corners[x];
+        v[x].color = color;
+        v[x].tex_coord = (SDL_FPoint){0, 0};
+    }
+    batch_close_quad(NULL);
+}
+
+// DRAWS THE QUADS OF run, ONLY THOSE TOUCHING clip WHEN GIVEN
+void batch_draw_run(State *state, BatchRun *run, const SDL_Rect *clip) {
+    SDL_FRect fclip = {0};
+    if (clip) fclip = (SDL_FRect){.x = clip->x, .y = clip->y, .w = clip->w, .h = clip->h};
+
+    if (run->txt == NULL) {
+        const SDL_FRect *rects = &BATCH.bounds[run->first];
+        int n = run->count;
+        if (clip) {
+            n = 0;
+            for (int x = run->first; x < run->first + run->count; x++) {
+                if (SDL_HasIntersectionF(&BATCH.bounds[x], &fclip)) BATCH.scratch_rects[n++] = BATCH.bounds[x];
+            }
+            rects = BATCH.scratch_rects;
+        }
+        if (n == 0) return;
+        CHECK_ERROR_int(SDL_SetRenderDrawColor(BATCH.renderer, run->color.r, run->color.g, run->color.b, run->color.a), state);
+        CHECK_ERROR_int(SDL_RenderFillRectsF(BATCH.renderer, rects, n), state);
+        CHECK_ERROR_int(SDL_SetRenderDrawColor(BATCH.renderer, 255, 255, 255, 255), state);
+        BATCH.flushes++;
+        return;
+    }
+
+    const int *indices = BATCH.indices;
+    int n = run->count;
+    if (clip) {
+        n = 0;
+        for (int x = run->first; x < run->first + run->count; x++) {
+            if (SDL_HasIntersectionF(&BATCH.bounds[x], &fclip)) {
+                SDL_memcpy(&BATCH.scratch_indices[n*6], &BATCH.indices[x*6], sizeof(int)*6);
+                n++;
+            }
+        }
+        indices = BATCH.scratch_indices;
+    } else {
+        indices = &BATCH.indices[run->first*6];
+    }
+    if (n == 0) return;
+    CHECK_ERROR_int(SDL_RenderGeometry(BATCH.renderer, run->txt, BATCH.vertices, BATCH.n_quads*4, indices, n*6), state);
+    BATCH.flushes++;
+}
+
+void dirty_mark(const SDL_FRect *r) {
+    int x0 = SDL_floorf(r->x)/DIRTY_TILE - 1;
+    int y0 = SDL_floorf(r->y)/DIRTY_TILE - 1;
+    int x1 = SDL_ceilf(r->x + r->w)/DIRTY_TILE + 1;
+    int y1 = SDL_ceilf(r->y + r->h)/DIRTY_TILE + 1;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > DIRTY_TILES_X) x1 = DIRTY_TILES_X;
+    if (y1 > DIRTY_TILES_Y) y1 = DIRTY_TILES_Y;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) BATCH.tiles[y][x] = true;
+    }
+}
+
+bool has_key(const Uint64 *sorted, int n, Uint64 key) {
+    int lo = 0;
+    int hi = n;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        if (sorted[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < n && sorted[lo] == key;
+}
+
+// DAMAGE == QUADS THAT APPEARED PLUS QUADS THAT DISAPPEARED SINCE LAST FRAME, ROUNDED TO TILES AND
+// MERGED INTO RECTANGLES: A ROW OF DAMAGED TILES BECOMES A RECT, RECTS WITH THE SAME SPAN ON CONSECUTIVE ROWS ARE JOINED.
+// THE SCROLLING SOIL MOVES EVERY FRAME, SO ITS TILES ALWAYS END UP AS ONE FULL-WIDTH STRIP.
+void dirty_regions() {
+    memset(BATCH.tiles, 0, sizeof(BATCH.tiles));
+    BATCH.n_regions = 0;
+
+    SDL_memcpy(BATCH.sorted_keys, BATCH.keys, sizeof(Uint64)*BATCH.n_quads);
+    qsort(BATCH.sorted_keys, BATCH.n_quads, sizeof(Uint64), compare_u64);
+    for (int x = 0; x < BATCH.n_quads; x++) {
+        if (!has_key(BATCH.prev_keys, BATCH.n_prev, BATCH.keys[x])) dirty_mark(&BATCH.bounds[x]);
+    }
+    for (int x = 0; x < BATCH.n_prev; x++) {
+        if (!has_key(BATCH.sorted_keys, BATCH.n_quads, BATCH.prev_keys[x])) dirty_mark(&BATCH.prev_bounds[x]);
+    }
+
+    int damaged = 0;
+    for (int y = 0; y < DIRTY_TILES_Y; y++) {
+        for (int x = 0; x < DIRTY_TILES_X; x++) damaged += BATCH.tiles[y][x];
+    }
+    if (BATCH.FULL_REDRAW || damaged*100 > DIRTY_TILES_X*DIRTY_TILES_Y*DIRTY_FULL_PERCENT) {
+        BATCH.regions[BATCH.n_regions++] = (SDL_Rect){.x = 0, .y = 0, .w = WINDOW_WIDTH, .h = WINDOW_HEIGHT};
+        BATCH.FULL_REDRAW = false;
+        return;
+    }
+
+    int first_of_prev_row = 0;
+    for (int y = 0; y < DIRTY_TILES_Y; y++) {
+        int first_of_row = BATCH.n_regions;
+        int x = 0;
+        while (x < DIRTY_TILES_X) {
+            if (!BATCH.tiles[y][x]) {
+                x++;
+                continue;
+            }
+            int start = x;
+            while (x < DIRTY_TILES_X && BATCH.tiles[y][x]) x++;
+            SDL_Rect r = {.x = start*DIRTY_TILE, .y = y*DIRTY_TILE, .w = (x - start)*DIRTY_TILE, .h = DIRTY_TILE};
+            if (x == DIRTY_TILES_X) r.w = WINDOW_WIDTH - r.x;
+            if (y == DIRTY_TILES_Y - 1) r.h = WINDOW_HEIGHT - r.y;
+
+            bool joined = false;
+            for (int i = first_of_prev_row; i < first_of_row; i++) {
+                SDL_Rect *above = &BATCH.regions[i];
+                if (above->x == r.x && above->w == r.w && above->y + above->h == r.y) {
+                    above->h += r.h;
+                    // KEEP IT AMONG THE REGIONS THE NEXT ROW CAN JOIN
+                    SDL_Rect tmp = *above;
+                    *above = BATCH.regions[first_of_row - 1];
+                    BATCH.regions[first_of_row - 1] = tmp;
+                    first_of_row--;
+                    joined = true;
+                    break;
                 }
             }
+            if (!joined) BATCH.regions[BATCH.n_regions++] = r;
         }
+        first_of_prev_row = first_of_row;
     }
 }
 
+void batch_flush(State *state) {
+    if (!BATCH.DIRTY) {
+        for (int x = 0; x < BATCH.n_runs; x++) batch_draw_run(state, &BATCH.runs[x], NULL);
+        BATCH.n_quads = 0;
+        BATCH.n_runs = 0;
+        return;
+    }
+
+    dirty_regions();
+    for (int r = 0; r < BATCH.n_regions; r++) {
+        SDL_Rect *region = &BATCH.regions[r];
+        CHECK_ERROR_int(SDL_RenderSetClipRect(BATCH.renderer, region), state);
+        CHECK_ERROR_int(SDL_SetRenderDrawColor(BATCH.renderer, 255, 255, 255, 255), state);
+        CHECK_ERROR_int(SDL_RenderFillRect(BATCH.renderer, region), state);
+        BATCH.repainted += region->w*region->h;
+        for (int x = 0; x < BATCH.n_runs; x++) batch_draw_run(state, &BATCH.runs[x], region);
+    }
+    CHECK_ERROR_int(SDL_RenderSetClipRect(BATCH.renderer, NULL), state);
+
+    SDL_memcpy(BATCH.prev_keys, BATCH.sorted_keys, sizeof(Uint64)*BATCH.n_quads);
+    SDL_memcpy(BATCH.prev_bounds, BATCH.bounds, sizeof(SDL_FRect)*BATCH.n_quads);
+    BATCH.n_prev = BATCH.n_quads;
+    BATCH.n_quads = 0;
+    BATCH.n_runs = 0;
+}
+
+void present_frame(SDL_Renderer *renderer, State *state) {
+    if (!BATCH.DIRTY) {
+        SDL_RenderPresent(renderer);
+        return;
+    }
+    CHECK_ERROR_int(SDL_RenderFlush(renderer), state);
+    if (BATCH.n_regions) CHECK_ERROR_int(SDL_UpdateWindowSurfaceRects(BATCH.window, BATCH.regions, BATCH.n_regions), state);
+}
+
+void arena_init(Arena *a, size_t size) {
+    a->base = (Uint8*)malloc(size);
+    a->size = a->base ? size : 0;
+    a->used = 0;
+}
+
+void arena_uninit(Arena *a) {
+    free(a->base);
+    memset(a, 0, sizeof(*a));
+}
+
+// NULL WHEN THE ARENA IS FULL
+void *arena_alloc(Arena *a, size_t size) {
+    size_t start = ((uintptr_t)a->base + a->used + ARENA_ALIGN - 1)/ARENA_ALIGN*ARENA_ALIGN - (uintptr_t)a->base;
+    if (start + size > a->size) return NULL;
+    a->used = start + size;
+    return a->base + start;
+}
+
+void arena_reset(Arena *a) {
+    a->used = 0;
+}
+
+void init_entities(EntityStore *E, Arena *arena) {
+    memset(E, 0, sizeof(*E));
+    E->size = MAX_ENTITIES;
+    E->x = (float*)arena_alloc(arena, sizeof(float)*E->size);
+    E->y = (float*)arena_alloc(arena, sizeof(float)*E->size);
+    E->px = (float*)arena_alloc(arena, sizeof(float)*E->size);
+    E->py = (float*)arena_alloc(arena, sizeof(float)*E->size);
+    E->w = (float*)arena_alloc(arena, sizeof(float)*E->size);
+    E->h = (float*)arena_alloc(arena, sizeof(float)*E->size);
+    E->type = (EntityType*)arena_alloc(arena, sizeof(EntityType)*E->size);
+    E->frame = (Uint8*)arena_alloc(arena, sizeof(Uint8)*E->size);
+    E->hit = (int*)arena_alloc(arena, sizeof(int)*E->size);
+}
+
+// EVERY ALLOCATION OF start_session PLUS ITS WORST CASE ALIGNMENT PADDING
+size_t session_bytes() {
+    size_t entity = sizeof(float)*6 + sizeof(EntityType) + sizeof(Uint8) + sizeof(int);
+    return MAX_ENTITIES*entity + sizeof(BulletPool) + sizeof(ParticlePool) + 11*ARENA_ALIGN;
+}
+
+// EMPTY STORE AND POOLS, ANYTHING CARVED BEFORE IS GONE
+void start_session(Session *S) {
+    arena_reset(&S->arena);
+    init_entities(&S->Entities, &S->arena);
+    S->Bullets = (BulletPool*)arena_alloc(&S->arena, sizeof(BulletPool));
+    S->Bullets->count = 0;
+    S->Particles = (ParticlePool*)arena_alloc(&S->arena, sizeof(ParticlePool));
+    S->Particles->count = 0;
+}
+
+bool init_session(Session *S) {
+    memset(S, 0, sizeof(*S));
+    arena_init(&S->arena, session_bytes());
+    if (S->arena.base == NULL) return false;
+    start_session(S);
+    return true;
+}
+
+void uninit_session(Session *S) {
+    arena_uninit(&S->arena);
+    memset(S, 0, sizeof(*S));
+}
+
+// RETURNS THE SLOT OF THE NEW ENTITY, E->size == STORE FULL AND THE ENTITY IS DROPPED
+size_t push_entity(EntityStore *E, EntityType type, Uint8 frame, SDL_FRect dst) {
+    if (E->count == E->size) return E->size;
+    size_t i = E->count++;
+    E->x[i] = E->px[i] = dst.x;
+    E->y[i] = E->py[i] = dst.y;
+    E->w[i] = dst.w;
+    E->h[i] = dst.h;
+    E->type[i] = type;
+    E->frame[i] = frame;
+    return i;
+}
+
+void remove_entity(EntityStore *E, size_t i) {
+    size_t last = --E->count;
+    E->x[i] = E->x[last];
+    E->y[i] = E->y[last];
+    E->px[i] = E->px[last];
+    E->py[i] = E->py[last];
+    E->w[i] = E->w[last];
+    E->h[i] = E->h[last];
+    E->type[i] = E->type[last];
+    E->frame[i] = E->frame[last];
+}
+
+SpriteId entity_sprite(const EntityStore *E, size_t i) {
+    return ENTITY_SPRITES[E->type[i]] + E->frame[i];
+}
+
 float get_gun_angle(Asset *Gun) {
-    int mouse_x;
-    int mouse_y;
-    SDL_GetMouseState(&mouse_x, &mouse_y);
+    int mouse_x = INPUT.mouse_x;
+    int mouse_y = INPUT.mouse_y;
 
     SDL_FPoint c = {
         .x = GUN_W/8.0f,
@@ -474,152 +1747,214 @@ float get_gun_angle(Asset *Gun) {
     return angle;
 }
 
-void display_dino_back_gun_cloud_vol(State *state, SDL_Renderer *renderer, DArrayOfEntities *DAe, Assets *A) {
-    for (size_t x = 0; x < DAe->size; x++) {
-        if (DAe->data[x] && DAe->data[x]->txt == A->Cloud->txt) {
-            Asset *current = DAe->data[x];
-            CHECK_ERROR_int(SDL_RenderCopyF(renderer, current->txt, &current->src, &current->dst), state);
-        }
+void display_entity(State *state, EntityStore *E, size_t x, Assets *A, float alpha) {
+    SDL_FRect dst = {.x = lerp(E->px[x], E->x[x], alpha), .y = lerp(E->py[x], E->y[x], alpha), .w = E->w[x], .h = E->h[x]};
+    batch_copy(state, A->Atlas.txt, &A->Atlas.rects[entity_sprite(E, x)], &dst);
+}
+
+void display_dino_back_gun_cloud_vol(State *state, EntityStore *E, Assets *A, float alpha) {
+    for (size_t x = 0; x < E->count; x++) {
+        if (E->type[x] == ENTITY_CLOUD) display_entity(state, E, x, A, alpha);
     }
 
     #define N_ASSETS_M 5
     Asset *arrayOfAssets[N_ASSETS_M] = {A->Back_1, A->Back_2, A->Dino, A->Gun, A->Vol};
     for (int x = 0; x < N_ASSETS_M; x++) {
         Asset *ptr = arrayOfAssets[x];
-        if (ptr && ptr->txt == A->Gun->txt){
-            CHECK_ERROR_int(SDL_RenderCopyExF(renderer, ptr->txt, &ptr->src, &ptr->dst, get_gun_angle(A->Gun), &(SDL_FPoint){ .x = GUN_W/8.0f, .y = GUN_H*2.0f/3.0f}, SDL_FLIP_NONE), state);
+        if (ptr == A->Gun){
+            if (state->LATE_LATCH || state->IDLE) continue;
+            batch_copy_rotated(state, A, SPRITE_GUN, &ptr->src, &ptr->dst, get_gun_angle(A->Gun), &(SDL_FPoint){ .x = GUN_W/8.0f, .y = GUN_H*2.0f/3.0f});
+            continue;
+        }
+        if (ptr == A->Back_1 || ptr == A->Back_2) {
+            // NO BLENDING ACROSS THE JUMP BACK TO THE RIGHT OF THE WINDOW
+            SDL_FRect dst = ptr->dst;
+            if (SDL_fabsf(ptr->dst.x - ptr->prev_x) < WINDOW_WIDTH) dst.x = lerp(ptr->prev_x, ptr->dst.x, alpha);
+            batch_copy(state, ptr->txt, &ptr->src, &dst);
             continue;
         }
         if (ptr && ptr->txt) {
-            CHECK_ERROR_int(SDL_RenderCopyF(renderer, ptr->txt, &ptr->src, &ptr->dst), state);
+            batch_copy(state, ptr->txt, &ptr->src, &ptr->dst);
         };
     }
 }
 
-void display_entities(State *state, Assets *A, SDL_Renderer *renderer, DArrayOfEntities *DAe) {
-    for (size_t x = 0; x < DAe->size; x++) {
-        if (DAe->data[x] && DAe->data[x]->txt != A->Cloud->txt) {
-            Asset *current = DAe->data[x];
-            CHECK_ERROR_int(SDL_RenderCopyF(renderer, current->txt, &current->src, &current->dst), state);
-        }
+void display_entities(State *state, EntityStore *E, Assets *A, float alpha) {
+    for (size_t x = 0; x < E->count; x++) {
+        if (E->type[x] != ENTITY_CLOUD) display_entity(state, E, x, A, alpha);
     }
 }
 
-void display_bullets(State *state, SDL_Renderer *renderer, DArrayOfBullets *Bullets) {
-     for (size_t x = 0; x < Bullets->size; x++) {
-        if (Bullets->data[x]) {
-            AssetRot *current = Bullets->data[x];
-            CHECK_ERROR_int(SDL_RenderCopyExF(renderer, current->txt, &current->src, &current->dst, current->angle, &current->rot_c, SDL_FLIP_NONE), state);
-        }
+void display_bullets(State *state, BulletPool *B, Assets *A, float alpha) {
+    SDL_FPoint center = {.x = 0, .y = 0};
+    for (size_t x = 0; x < B->count; x++) {
+        SDL_FRect dst = {.x = lerp(B->px[x], B->x[x], alpha), .y = lerp(B->py[x], B->y[x], alpha), .w = BULLET_W, .h = BULLET_H};
+        batch_copy_rotated(state, A, SPRITE_BULLET, &A->Bullet->src, &dst, B->angle[x], &center);
     }
 }
 
-void display_gsight(State *state, Assets *A, SDL_Renderer *renderer) {
+void display_gsight(State *state, Assets *A) {
     Asset *ptr = A->Gsight;
-    int mouse_x;
-    int mouse_y;
-    SDL_GetMouseState(&mouse_x, &mouse_y);
-    ptr->dst.x = mouse_x - GSIGHT_W/2 + sinf((get_gun_angle(A->Gun)/360.f)*2*PI)*(GSIGHT_W/2 - BULLET_H);
-    ptr->dst.y = mouse_y - GSIGHT_H/2 - cosf((get_gun_angle(A->Gun)/360.f)*2*PI)*(GSIGHT_H/2 - BULLET_H);
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, ptr->txt, &ptr->src, &ptr->dst), state);
-}
-
-void display_particles(State *state, SDL_Renderer *renderer, DArrayOfParticlesCLusters *Clusters) {
-    for (size_t x = 0; x < Clusters->size; x++) {
-        DArrayOfParticles *c = Clusters->data[x];
-        if (c != NULL) {
-            for (size_t y = 0; y < c->size; y++) {
-                Particle *p = c->data[y];
-                if (p != NULL) {
-                    CHECK_ERROR_int(SDL_SetRenderDrawColor(renderer, 76,76,76,255), state);
-                    SDL_Rect r = {
-                        .x = p->dst.x,
-                        .y = p->dst.y,
-                        .w = p->dst.w,
-                        .h = p->dst.h
-                    };
-                    CHECK_ERROR_int(SDL_RenderDrawRect(renderer, &r), state);
-                    CHECK_ERROR_int(SDL_RenderFillRect(renderer, &r), state);
-                    CHECK_ERROR_int(SDL_SetRenderDrawColor(renderer, 255,255,255,255), state);
-                }
-            }
-        }
+    float angle = (get_gun_angle(A->Gun)/360.f)*2*PI;
+    ptr->dst.x = INPUT.mouse_x - GSIGHT_W/2 + sinf(angle)*(GSIGHT_W/2 - BULLET_H);
+    ptr->dst.y = INPUT.mouse_y - GSIGHT_H/2 - cosf(angle)*(GSIGHT_H/2 - BULLET_H);
+    batch_copy(state, ptr->txt, &ptr->src, &ptr->dst);
+}
+
+void display_particles(State *state, ParticlePool *P, float alpha) {
+    for (size_t x = 0; x < P->count; x++) {
+        // SAME PIXELS AS THE OLD SDL_Rect CONVERSION
+        SDL_FRect r = {
+            .x = (int)lerp(P->px[x], P->x[x], alpha),
+            .y = (int)lerp(P->py[x], P->y[x], alpha),
+            .w = (int)PARTICLE_SIZE,
+            .h = (int)PARTICLE_SIZE
+        };
+        batch_fill(state, &r, (SDL_Color){76, 76, 76, 255});
     }
 }
 
-void display_points(SDL_Renderer *renderer, State *state, TTF_Font *font) {
-    size_t n_numbers;
-    char *points;
-    if (state->POINTS == 0) {
-        n_numbers = 8;
-        points = "SCORE: 0";
-    } else {
-        n_numbers = floorf(log10(state->POINTS)) + 9;
-        points = malloc(sizeof(char)*(n_numbers + 7));
-        sprintf(points, "SCORE: ");
-        SDL_itoa(state->POINTS, points + 7, 10);
+// RASTERIZES HUD_CHARSET ONCE, THE HUD IS THEN DRAWN WITH ONE ATLAS BLIT PER CHAR
+void init_glyph_atlas(SDL_Renderer *renderer, State *state, TextCache *texts) {
+    GlyphAtlas *g = &texts->glyphs;
+    SDL_Surface *srfs[sizeof(HUD_CHARSET)] = {0};
+    const char *charset = HUD_CHARSET;
+    int w = 0;
+    int h = 0;
+
+    for (size_t x = 0; charset[x]; x++) {
+        if (strchr(charset, charset[x]) != charset + x) continue; // duplicated char
+        srfs[x] = TTF_RenderGlyph_Solid(texts->font, charset[x], (SDL_Color) {0, 0, 0, 255});
+        CHECK_ERROR_ptr(srfs[x], state);
+        if (srfs[x] == NULL) continue;
+        w += srfs[x]->w + 1;
+        if (srfs[x]->h > h) h = srfs[x]->h;
     }
-    
-    SDL_Surface *srf = TTF_RenderText_Solid(font, points, (SDL_Color) {0, 0, 0, 255});
-    CHECK_ERROR_ptr(srf, state);
 
-    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
-    SDL_FRect dst = {
-        .w = n_numbers * FACTOR*30/100,
-        .h =  FACTOR*50/100,
-        .x = WINDOW_WIDTH - n_numbers * FACTOR*30/100 - FACTOR*30/100,
-        .y = FACTOR*10/100
-    };
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    CHECK_ERROR_ptr(atlas, state);
+    int pen = 0;
+    for (size_t x = 0; charset[x]; x++) {
+        if (srfs[x] == NULL) continue;
+        SDL_Rect r = {.x = pen, .y = 0, .w = srfs[x]->w, .h = srfs[x]->h};
+        if (atlas) SDL_BlitSurface(srfs[x], NULL, atlas, &r);
+        g->glyphs[(int)charset[x]] = r;
+        pen += srfs[x]->w + 1;
+        SDL_FreeSurface(srfs[x]);
+    }
+    g->height = h;
+    if (atlas) {
+        g->txt = SDL_CreateTextureFromSurface(renderer, atlas);
+        CHECK_ERROR_ptr(g->txt, state);
+        SDL_FreeSurface(atlas);
+    }
+    texts->points.valid = false;
+    texts->ammo.valid = false;
+}
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst), state);
-    if (state->POINTS != 0) free(points);
-    SDL_FreeSurface(srf);
-    SDL_DestroyTexture(txt);
+void destroy_glyph_atlas(TextCache *texts) {
+    if (texts->glyphs.txt) SDL_DestroyTexture(texts->glyphs.txt);
+    memset(&texts->glyphs, 0, sizeof(texts->glyphs));
 }
 
-void display_ammo(SDL_Renderer *renderer, State *state, TTF_Font *font) {
-    size_t n_numbers;
-    char *ammo;
-    if (state->AMMO == 0) {
-        n_numbers = 8;
-        ammo = "AMMO: 0";
-    } else {
-        n_numbers = floorf(log10(state->AMMO)) + 8;
-        ammo = malloc(sizeof(char)*(n_numbers + 6));
-        sprintf(ammo, "AMMO: ");
-        SDL_itoa(state->AMMO, ammo + 6, 10);
+// STRETCHES text OVER box THE SAME WAY A SINGLE TTF TEXTURE WOULD BE
+void layout_hud_line(HudLine *line, GlyphAtlas *g, const char *text, SDL_FRect box) {
+    float text_w = 0;
+    line->n = 0;
+    for (size_t x = 0; text[x] && line->n < HUD_MAX_GLYPHS; x++) {
+        SDL_Rect r = g->glyphs[text[x] & 127];
+        if (r.w == 0) continue;
+        line->src[line->n++] = r;
+        text_w += r.w;
     }
-    
-    SDL_Surface *srf = TTF_RenderText_Solid(font, ammo, (SDL_Color) {0, 0, 0, 255});
-    CHECK_ERROR_ptr(srf, state);
+    float scale = text_w > 0 ? box.w/text_w : 0;
+    float pen = box.x;
+    for (int x = 0; x < line->n; x++) {
+        line->dst[x] = (SDL_FRect){.x = pen, .y = box.y, .w = line->src[x].w*scale, .h = box.h};
+        pen += line->dst[x].w;
+    }
+}
 
-    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
-    SDL_FRect dst = {
-        .w = n_numbers * FACTOR*30/100,
-        .h =  FACTOR*50/100,
-        .x = WINDOW_WIDTH/20,
-        .y = FACTOR*10/100
-    };
+void draw_hud_line(State *state, GlyphAtlas *g, HudLine *line) {
+    for (int x = 0; x < line->n; x++) {
+        batch_copy(state, g->txt, &line->src[x], &line->dst[x]);
+    }
+}
+
+void display_points(State *state, TextCache *texts) {
+    HudLine *line = &texts->points;
+    if (!line->valid || line->value != state->POINTS) {
+        char points[HUD_MAX_GLYPHS];
+        size_t n_numbers = state->POINTS == 0 ? 8 : floorf(log10(state->POINTS)) + 9;
+        SDL_snprintf(points, sizeof(points), "SCORE: %zu", state->POINTS);
+        SDL_FRect dst = {
+            .w = n_numbers * FACTOR*30/100,
+            .h =  FACTOR*50/100,
+            .x = WINDOW_WIDTH - n_numbers * FACTOR*30/100 - FACTOR*30/100,
+            .y = FACTOR*10/100
+        };
+        layout_hud_line(line, &texts->glyphs, points, dst);
+        line->value = state->POINTS;
+        line->valid = true;
+    }
+    draw_hud_line(state, &texts->glyphs, line);
+}
+
+void display_ammo(State *state, TextCache *texts) {
+    HudLine *line = &texts->ammo;
+    if (!line->valid || line->value != state->AMMO) {
+        char ammo[HUD_MAX_GLYPHS];
+        size_t n_numbers = state->AMMO == 0 ? 8 : floorf(log10(state->AMMO)) + 8;
+        SDL_snprintf(ammo, sizeof(ammo), "AMMO: %zu", state->AMMO);
+        SDL_FRect dst = {
+            .w = n_numbers * FACTOR*30/100,
+            .h =  FACTOR*50/100,
+            .x = WINDOW_WIDTH/20,
+            .y = FACTOR*10/100
+        };
+        layout_hud_line(line, &texts->glyphs, ammo, dst);
+        line->value = state->AMMO;
+        line->valid = true;
+    }
+    draw_hud_line(state, &texts->glyphs, line);
+}
+
+void destroy_text_cache(TextCache *texts) {
+    for (int x = 0; x < N_TEXTS; x++) {
+        if (texts->screens[x]) SDL_DestroyTexture(texts->screens[x]);
+        texts->screens[x] = NULL;
+    }
+    destroy_glyph_atlas(texts);
+}
+
+// DROPS EVERY CACHED TEXTURE WHEN THE FONT OR THE OUTPUT SIZE CHANGED SINCE THEY WERE RENDERED
+void validate_text_cache(SDL_Renderer *renderer, State *state, TextCache *texts) {
+    if (texts->built_font == texts->font) return;
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst), state);
-    if (state->AMMO != 0) free(ammo);
-    SDL_FreeSurface(srf);
-    SDL_DestroyTexture(txt);
+    destroy_text_cache(texts);
+    texts->built_font = texts->font;
+    if (texts->font) init_glyph_atlas(renderer, state, texts);
 }
 
-void display_menu(SDL_Renderer *renderer, State *state, TTF_Font *font) {
-    char *text = "Press [ESC] to pause or exit (if already paused)\n\
-Press [SPACE] to shoot\n\
-Press [P] to pause or resume\n\
-Press [R] to restart\n\
-Press [ARROW UP] to increase volume\n\
-Press [ARROW DOWN] to decrease volume\n\
-Press [M] to mute volume";
+SDL_Texture *get_text(SDL_Renderer *renderer, State *state, TextCache *texts, TextId id) {
+    if (texts->screens[id]) return texts->screens[id];
 
-    SDL_Surface *srf = TTF_RenderText_Solid_Wrapped(font, text, (SDL_Color) {0, 0, 0, 255}, 0);
+    SDL_Surface *srf;
+    if (STATIC_TEXTS[id].wrapped) {
+        srf = TTF_RenderText_Solid_Wrapped(texts->font, STATIC_TEXTS[id].text, (SDL_Color) {0, 0, 0, 255}, 0);
+    } else {
+        srf = TTF_RenderText_Solid(texts->font, STATIC_TEXTS[id].text, (SDL_Color) {0, 0, 0, 255});
+    }
     CHECK_ERROR_ptr(srf, state);
+    if (srf == NULL) return NULL;
 
-    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
+    texts->screens[id] = SDL_CreateTextureFromSurface(renderer, srf);
+    CHECK_ERROR_ptr(texts->screens[id], state);
+    SDL_FreeSurface(srf);
+    return texts->screens[id];
+}
+
+void display_menu(SDL_Renderer *renderer, State *state, TextCache *texts) {
     #define N_LINES 7
     SDL_FRect dst = {
         .w = 48 * FACTOR*20/100,
@@ -628,17 +1963,10 @@ Press [M] to mute volume";
         .y = WINDOW_HEIGHT*3/7
     };
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst), state);
-    SDL_FreeSurface(srf);
-    SDL_DestroyTexture(txt);
+    batch_copy(state, get_text(renderer, state, texts, TEXT_MENU), NULL, &dst);
 }
 
-void display_start(SDL_Renderer *renderer, State *state, TTF_Font *font) {
-    char *text = "PRESS SPACE TO START";
-    SDL_Surface *srf = TTF_RenderText_Solid(font, text, (SDL_Color) {0, 0, 0, 255});
-    CHECK_ERROR_ptr(srf, state);
-
-    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
+void display_start(SDL_Renderer *renderer, State *state, TextCache *texts) {
     SDL_FRect dst = {
         .w = 21 * FACTOR*50/100,
         .h =  FACTOR,
@@ -646,19 +1974,10 @@ void display_start(SDL_Renderer *renderer, State *state, TTF_Font *font) {
         .y = WINDOW_HEIGHT/5
     };
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst), state);
-    SDL_FreeSurface(srf);
-    SDL_DestroyTexture(txt);
+    batch_copy(state, get_text(renderer, state, texts, TEXT_START), NULL, &dst);
 }
 
-void display_gameover(SDL_Renderer *renderer, State *state, TTF_Font *font) {
-    char *text = "GAMEOVER!";
-    char *subtext = "press [R] to restart or [ESC] to exit";
-
-    SDL_Surface *srf = TTF_RenderText_Solid_Wrapped(font, text, (SDL_Color) {0, 0, 0, 255}, 0);
-    CHECK_ERROR_ptr(srf, state);
-
-    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
+void display_gameover(SDL_Renderer *renderer, State *state, TextCache *texts) {
     SDL_FRect dst = {
         .w = 10 * FACTOR*50/100,
         .h =  FACTOR,
@@ -666,14 +1985,8 @@ void display_gameover(SDL_Renderer *renderer, State *state, TTF_Font *font) {
         .y = WINDOW_HEIGHT/4
     };
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst), state);
-    SDL_FreeSurface(srf);
-    SDL_DestroyTexture(txt);
-
-    srf = TTF_RenderText_Solid_Wrapped(font, subtext, (SDL_Color) {0, 0, 0, 255}, 0);
-    CHECK_ERROR_ptr(srf, state);
+    batch_copy(state, get_text(renderer, state, texts, TEXT_GAMEOVER), NULL, &dst);
 
-    txt = SDL_CreateTextureFromSurface(renderer, srf);
     SDL_FRect dst_s = {
         .w = 38 * FACTOR*20/100,
         .h =  FACTOR*50/100,
@@ -681,18 +1994,10 @@ void display_gameover(SDL_Renderer *renderer, State *state, TTF_Font *font) {
         .y = WINDOW_HEIGHT*3/7
     };
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst_s), state);
-    SDL_FreeSurface(srf);
-    SDL_DestroyTexture(txt);
-
+    batch_copy(state, get_text(renderer, state, texts, TEXT_GAMEOVER_SUB), NULL, &dst_s);
 }
 
-void display_pause(SDL_Renderer *renderer, State *state, TTF_Font *font) {
-    char *text = "PAUSE";
-    SDL_Surface *srf = TTF_RenderText_Solid(font, text, (SDL_Color) {0, 0, 0, 255});
-    CHECK_ERROR_ptr(srf, state);
-
-    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
+void display_pause(SDL_Renderer *renderer, State *state, TextCache *texts) {
     SDL_FRect dst = {
         .w = 5 * FACTOR*50/100,
         .h = FACTOR,
@@ -700,20 +2005,163 @@ void display_pause(SDL_Renderer *renderer, State *state, TTF_Font *font) {
         .y = WINDOW_HEIGHT/4
     };
 
-    CHECK_ERROR_int(SDL_RenderCopyF(renderer, txt, NULL, &dst), state);
+    batch_copy(state, get_text(renderer, state, texts, TEXT_PAUSE), NULL, &dst);
+}
+
+// START, GAMEOVER OR PAUSE TEXT, ON TOP OF THE SCENE
+void display_overlay(SDL_Renderer *renderer, State *state, TextCache *texts) {
+    if (state->START) {
+        PROFILE(PHASE_DISPLAY_START, display_start(renderer, state, texts));
+        PROFILE(PHASE_DISPLAY_MENU, display_menu(renderer, state, texts));
+    } else if (state->GAMEOVER) {
+        PROFILE(PHASE_DISPLAY_GAMEOVER, display_gameover(renderer, state, texts));
+    } else if (state->PAUSE) {
+        PROFILE(PHASE_DISPLAY_MENU, display_menu(renderer, state, texts));
+        PROFILE(PHASE_DISPLAY_PAUSE, display_pause(renderer, state, texts));
+    }
+}
+
+// THE MOUSE IS READ AGAIN AFTER THE REST OF THE SCENE IS DRAWN, SO THE GUN AND THE SIGHT ARE AS FRESH AS THE PRESENT.
+// THE OVERLAY TEXT STILL GOES ON TOP OF THEM, IN THE SAME FLUSH. THE MOTION PUMPED HERE IS STILL IN THE QUEUE FOR THE NEXT manage_events
+void display_late_latch(SDL_Renderer *renderer, State *state, Assets *A, TextCache *texts) {
+    SDL_PumpEvents();
+    SDL_GetMouseState(&INPUT.mouse_x, &INPUT.mouse_y);
+    PROFILE(PHASE_DISPLAY_SCENE, batch_copy_rotated(state, A, SPRITE_GUN, &A->Gun->src, &A->Gun->dst, get_gun_angle(A->Gun), &(SDL_FPoint){ .x = GUN_W/8.0f, .y = GUN_H*2.0f/3.0f}));
+    if (!state->HW_CURSOR) PROFILE(PHASE_DISPLAY_GSIGHT, display_gsight(state, A));
+    display_overlay(renderer, state, texts);
+    PROFILE(PHASE_BATCH_FLUSH, batch_flush(state));
+}
+
+void display(State *state, EntityStore *E, BulletPool *Bullets, ParticlePool *Particles, Assets *A, TextCache *texts, float alpha) {
+    PROFILE(PHASE_DISPLAY_SCENE, display_dino_back_gun_cloud_vol(state, E, A, alpha));
+    PROFILE(PHASE_DISPLAY_ENTITIES, display_entities(state, E, A, alpha));
+    PROFILE(PHASE_DISPLAY_BULLETS, display_bullets(state, Bullets, A, alpha));
+    PROFILE(PHASE_DISPLAY_PARTICLES, display_particles(state, Particles, alpha));
+    PROFILE(PHASE_DISPLAY_POINTS, display_points(state, texts));
+    PROFILE(PHASE_DISPLAY_AMMO, display_ammo(state, texts));
+    if (!state->LATE_LATCH && !state->IDLE && !state->HW_CURSOR) PROFILE(PHASE_DISPLAY_GSIGHT, display_gsight(state, A));
+}
+
+void profiler_end_frame() {
+    for (int x = 0; x < N_PHASES; x++) {
+        PROF.samples[x][PROF.head] = PROF.current[x];
+        PROF.totals[x] += PROF.current[x];
+        PROF.current[x] = 0;
+    }
+    PROF.head = (PROF.head + 1) % PROF_WINDOW;
+    if (PROF.filled < PROF_WINDOW) PROF.filled++;
+    PROF.frames++;
+}
+
+void record_latency(Latency kind, Uint64 since, Uint64 presented) {
+    if (since == 0) return;
+    Uint64 t = presented > since ? presented - since : 0;
+    PROF.latency[kind][PROF.latency_head[kind]] = t;
+    PROF.latency_head[kind] = (PROF.latency_head[kind] + 1) % PROF_WINDOW;
+    if (PROF.latency_filled[kind] < PROF_WINDOW) PROF.latency_filled[kind]++;
+    PROF.latency_totals[kind] += t;
+    PROF.latency_count[kind]++;
+}
+
+void draw_text(SDL_Renderer *renderer, State *state, TTF_Font *font, const char *text, int x, int y) {
+    SDL_Surface *srf = TTF_RenderText_Blended(font, text, (SDL_Color) {0, 0, 0, 255});
+    CHECK_ERROR_ptr(srf, state);
+    if (srf == NULL) return;
+
+    SDL_Texture *txt = SDL_CreateTextureFromSurface(renderer, srf);
+    SDL_Rect dst = {.x = x, .y = y, .w = srf->w, .h = srf->h};
+    CHECK_ERROR_int(SDL_RenderCopy(renderer, txt, NULL, &dst), state);
     SDL_FreeSurface(srf);
     SDL_DestroyTexture(txt);
 }
 
-void display(State *state, SDL_Renderer *renderer, DArrayOfEntities *DAe, DArrayOfBullets *Bullets, DArrayOfParticlesCLusters *Clusters, Assets *A, TTF_Font *font) {
-    display_dino_back_gun_cloud_vol(state, renderer, DAe, A);
-    display_entities(state, A, renderer, DAe);
-    display_bullets(state, renderer, Bullets);
-    display_particles(state, renderer, Clusters);
-    display_points(renderer, state, font);
-    display_ammo(renderer, state, font);
-    display_gsight(state, A, renderer);
+void display_profiler(State *state, SDL_Renderer *renderer, EntityStore *E, BulletPool *Bullets, ParticlePool *Particles) {
+    if (!PROF.SHOW || PROF.font == NULL || PROF.filled == 0) return;
+
+    double freq = SDL_GetPerformanceFrequency();
+    int line_h = TTF_FontLineSkip(PROF.font);
+    int x0 = FACTOR*10/100;
+    int y0 = FACTOR*80/100;
+    int col_w = FACTOR*90/100;
+    SDL_Rect panel = {
+        .x = x0 - 10,
+        .y = y0 - 10,
+        .w = 2*col_w + 3*col_w*2/3 + 20,
+        .h = (N_PHASES + N_LATENCIES + 4)*line_h + PROF_GRAPH_H + 30
+    };
+    CHECK_ERROR_int(SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND), state);
+    CHECK_ERROR_int(SDL_SetRenderDrawColor(renderer, 255, 255, 255, 200), state);
+    CHECK_ERROR_int(SDL_RenderFillRect(renderer, &panel), state);
+
+    char line[128];
+    draw_text(renderer, state, PROF.font, "phase (ms)", x0, y0);
+    draw_text(renderer, state, PROF.font, "min", x0 + 2*col_w, y0);
+    draw_text(renderer, state, PROF.font, "avg", x0 + 2*col_w + col_w*2/3, y0);
+    draw_text(renderer, state, PROF.font, "p99", x0 + 2*col_w + col_w*4/3, y0);
+
+    // PHASES, THEN INPUT LATENCIES
+    Uint64 sorted[PROF_WINDOW];
+    for (int x = 0; x < N_PHASES + N_LATENCIES; x++) {
+        bool phase = x < N_PHASES;
+        const Uint64 *samples = phase ? PROF.samples[x] : PROF.latency[x - N_PHASES];
+        size_t filled = phase ? PROF.filled : PROF.latency_filled[x - N_PHASES];
+        int y = y0 + (x + 1)*line_h;
+        draw_text(renderer, state, PROF.font, phase ? PHASE_NAMES[x] : LATENCY_NAMES[x - N_PHASES], x0, y);
+        if (filled == 0) continue;
+        Uint64 sum = 0;
+        for (size_t y = 0; y < filled; y++) {
+            sorted[y] = samples[y];
+            sum += sorted[y];
+        }
+        qsort(sorted, filled, sizeof(Uint64), compare_u64);
+        SDL_snprintf(line, sizeof(line), "%.3f", sorted[0]*1000.0/freq);
+        draw_text(renderer, state, PROF.font, line, x0 + 2*col_w, y);
+        SDL_snprintf(line, sizeof(line), "%.3f", sum*1000.0/freq/filled);
+        draw_text(renderer, state, PROF.font, line, x0 + 2*col_w + col_w*2/3, y);
+        SDL_snprintf(line, sizeof(line), "%.3f", sorted[(filled - 1)*99/100]*1000.0/freq);
+        draw_text(renderer, state, PROF.font, line, x0 + 2*col_w + col_w*4/3, y);
+    }
 
+    double interval_avg = 0;
+    double interval_var = 0;
+    for (size_t x = 0; x < PROF.filled; x++) interval_avg += PROF.samples[PHASE_FRAME_INTERVAL][x]*1000.0/freq/PROF.filled;
+    for (size_t x = 0; x < PROF.filled; x++) {
+        double d = PROF.samples[PHASE_FRAME_INTERVAL][x]*1000.0/freq - interval_avg;
+        interval_var += d*d/PROF.filled;
+    }
+    SDL_snprintf(line, sizeof(line), "entities: %zu  bullets: %zu  particles: %zu", E->count, Bullets->count, Particles->count);
+    draw_text(renderer, state, PROF.font, line, x0, y0 + (N_PHASES + N_LATENCIES + 1)*line_h);
+    SDL_snprintf(line, sizeof(line), "frame interval sd: %.3f ms", SDL_sqrt(interval_var));
+    draw_text(renderer, state, PROF.font, line, x0, y0 + (N_PHASES + N_LATENCIES + 2)*line_h);
+
+    // FRAME-TIME GRAPH, OLDEST SAMPLE ON THE LEFT, RED BARS ARE OVER THE FRAME BUDGET
+    SDL_Rect ok[PROF_WINDOW];
+    SDL_Rect over[PROF_WINDOW];
+    int n_ok = 0;
+    int n_over = 0;
+    int graph_y = y0 + (N_PHASES + N_LATENCIES + 3)*line_h + PROF_GRAPH_H;
+    int bar_w = panel.w/PROF_WINDOW > 0 ? panel.w/PROF_WINDOW : 1;
+    double budget = freq/FPS;
+    for (size_t x = 0; x < PROF.filled; x++) {
+        size_t slot = (PROF.head + PROF_WINDOW - PROF.filled + x) % PROF_WINDOW;
+        Uint64 t = PROF.samples[PHASE_FRAME][slot];
+        int h = t/budget*PROF_GRAPH_H/2;
+        if (h > PROF_GRAPH_H) h = PROF_GRAPH_H;
+        if (h < 1) h = 1;
+        SDL_Rect bar = {.x = panel.x + x*bar_w, .y = graph_y - h, .w = bar_w, .h = h};
+        if (t > budget) {
+            over[n_over++] = bar;
+        } else {
+            ok[n_ok++] = bar;
+        }
+    }
+    CHECK_ERROR_int(SDL_SetRenderDrawColor(renderer, 76, 76, 76, 255), state);
+    if (n_ok) CHECK_ERROR_int(SDL_RenderFillRects(renderer, ok, n_ok), state);
+    CHECK_ERROR_int(SDL_SetRenderDrawColor(renderer, 220, 40, 40, 255), state);
+    if (n_over) CHECK_ERROR_int(SDL_RenderFillRects(renderer, over, n_over), state);
+    CHECK_ERROR_int(SDL_RenderDrawLine(renderer, panel.x, graph_y - PROF_GRAPH_H/2, panel.x + panel.w, graph_y - PROF_GRAPH_H/2), state);
+    CHECK_ERROR_int(SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255), state);
+    CHECK_ERROR_int(SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE), state);
 }
 
 void animate_soil(Assets *A)  {
@@ -724,187 +2172,238 @@ void animate_soil(Assets *A)  {
 
     if (*x1 <= -WINDOW_WIDTH) {
         *x1 = WINDOW_WIDTH;
-        A->Back_1->txt = A->Backs[rand()%3];
+        set_sprite(A, A->Back_1, SPRITE_BACK_1 + rng_below(RNG_VISUALS, 3));
     } 
 
     if (*x2 <= -WINDOW_WIDTH) {
         *x2 = WINDOW_WIDTH;
-        A->Back_2->txt = A->Backs[rand()%3];
+        set_sprite(A, A->Back_2, SPRITE_BACK_1 + rng_below(RNG_VISUALS, 3));
     }
 }
 
-void animate_dino(Assets* A, Animations_start *starts, size_t now, Sounds *sounds) {
-    if (now - starts->Dino_start >= (size_t)1000/(SPEED*(FPS/60.0f))) {
-        starts->Dino_start = SDL_GetTicks();
-        SDL_Texture *tmp = A->Dinos_txt;
-        A->Dinos_txt = A->Dino->txt;
-        A->Dino->txt = tmp;
-        Mix_PlayChannel(-1, sounds->stepl_sound, 0);
-        Mix_Chunk *tmpc = sounds->stepl_sound;
-        sounds->stepl_sound = sounds->stepr_sound;
-        sounds->stepr_sound = tmpc;
-    } else if (starts->Dino_start > now){
-        starts->Dino_start = SDL_GetTicks();
-    }
-    
+void animate_dino(Assets* A, TimerWheel *timers, Sounds *sounds) {
+    if (!timer_take(timers, TIMER_DINO_STEP)) return;
+    timer_repeat(timers, TIMER_DINO_STEP);
+    set_sprite(A, A->Dino, A->Dino->sprite == SPRITE_DINO_L ? SPRITE_DINO_R : SPRITE_DINO_L);
+    Mix_PlayChannel(-1, sounds->stepl_sound, 0);
+    Mix_Chunk *tmpc = sounds->stepl_sound;
+    sounds->stepl_sound = sounds->stepr_sound;
+    sounds->stepr_sound = tmpc;
+}
+
+// TRUE WHEN THE OPAQUE PIXELS OF ENTITY x TOUCH THE DINO'S
+bool hits_dino(Assets *A, EntityStore *E, size_t x) {
+    const CollisionMask *masks = A->Atlas.masks;
+    return masks_overlap(&masks[A->Dino->sprite], SDL_floorf(A->Dino->dst.x), SDL_floorf(A->Dino->dst.y),
+        &masks[entity_sprite(E, x)], SDL_floorf(E->x[x]), SDL_floorf(E->y[x]));
 }
 
-void animate_entities(Assets *A, DArrayOfEntities *DAe, Animations_start *starts, size_t now, State *state, Sounds *sounds) {
-    bool reset_t = false;
+void animate_entities(Assets *A, EntityStore *E, TimerWheel *timers, State *state, Sounds *sounds) {
     int dino_x = WINDOW_WIDTH/10 + DINO_W;
     int dino_y = WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - DINO_H + (DINO_H - DINO_H*200/286);
-    for (size_t x=0; x < DAe->size; x++) {
-        if (DAe->data[x] && (DAe->data[x]->txt == A->Bird_Up->txt || DAe->data[x]->txt == A->Bird_Down->txt)) {
-            if (DAe->data[x]->dst.x <= dino_x){
-                state->GAMEOVER = true;
-                Mix_PlayChannel(-1, sounds->death_sound, 0);
-                continue;
-            }
-
-            int dino_x_dist = DAe->data[x]->dst.x - dino_x;
-            int dino_y_dist = DAe->data[x]->dst.y - dino_y;
+    bool flap = timer_take(timers, TIMER_BIRD_FLAP);
+    if (flap) timer_repeat(timers, TIMER_BIRD_FLAP);
+    size_t x = 0;
+    while (x < E->count) {
+        if (E->type[x] != ENTITY_CLOUD && hits_dino(A, E, x)) {
+            if (!state->GAMEOVER) TRACE_INSTANT("gameover");
+            state->GAMEOVER = true;
+            Mix_PlayChannel(-1, sounds->death_sound, 0);
+            x++;
+            continue;
+        }
+        if (E->x[x] <= -E->w[x]) {
+            // A BIRD OR A CACTUS ONLY GETS HERE IF IT SLIPPED PAST THE DINO WITHOUT TOUCHING IT
+            remove_entity(E, x);
+            continue;
+        }
+        if (E->type[x] == ENTITY_BIRD) {
+            int dino_x_dist = E->x[x] - dino_x;
+            int dino_y_dist = E->y[x] - dino_y;
             
-            if (dino_x_dist > 0 && DAe->data[x]->dst.x <= rand()%(WINDOW_WIDTH/2) + WINDOW_WIDTH/2) {
+            if (dino_x_dist > 0 && E->x[x] <= rng_below(RNG_SPAWN, WINDOW_WIDTH/2) + WINDOW_WIDTH/2) {
                 float dino_x_norm = (float)dino_x_dist/(dino_x_dist + abs(dino_y_dist));
                 float dino_y_norm = (float)dino_y_dist/(dino_x_dist + abs(dino_y_dist));
-                DAe->data[x]->dst.y -= SPEED*dino_y_norm;
-                DAe->data[x]->dst.x -= SPEED*dino_x_norm;
+                E->y[x] -= SPEED*dino_y_norm;
+                E->x[x] -= SPEED*dino_x_norm;
             } else {
-                DAe->data[x]->dst.x -= SPEED;
+                E->x[x] -= SPEED;
             }
 
-            if (now - starts->Bird_flap >= 300) {
-                if(DAe->data[x]->txt == A->Bird_Down->txt) {
-                    DAe->data[x]->txt = A->Bird_Up->txt;
-                } else if (DAe->data[x]->txt == A->Bird_Up->txt){
-                    DAe->data[x]->txt = A->Bird_Down->txt;
-                }
-                reset_t = true;
-            }
-        } else if (DAe->data[x] && (DAe->data[x]->txt == A->Cactus_1->txt || DAe->data[x]->txt == A->Cactus_2->txt || DAe->data[x]->txt == A->Cactus_3->txt) ) {
-            if (DAe->data[x]->dst.x <= dino_x - dino_x/4){
-                state->GAMEOVER = true;
-                Mix_PlayChannel(-1, sounds->death_sound, 0);
-                continue;
-            }
-            DAe->data[x]->dst.x -= SPEED;
-        } else if (DAe->data[x] && DAe->data[x]->txt == A->Cloud->txt){
-            if (DAe->data[x]->dst.x <= -CLOUD_W){
-                free(DAe->data[x]);
-                DAe->data[x] = NULL;
-                DAe->count--;
-                continue;
-            }
-            DAe->data[x]->dst.x -= SPEED;
+            if (flap) E->frame[x] ^= 1;
+        } else {
+            E->x[x] -= SPEED;
         }
+        x++;
     }
-    if (reset_t) starts->Bird_flap = SDL_GetTicks();
 }
 
-void animate_bullets(DArrayOfBullets *DAb) {
-    for (size_t x = 0; x < DAb->size; x++) {
-        if (DAb->data[x]) {
-            if (DAb->data[x]->dst.x >= WINDOW_WIDTH || DAb->data[x]->dst.x <= -BULLET_W || DAb->data[x]->dst.y >= WINDOW_HEIGHT || DAb->data[x]->dst.y <= -BULLET_H) {
-                free(DAb->data[x]);
-                DAb->data[x] = NULL;
-                DAb->count--;
-                continue;
-            }
-            DAb->data[x]->dst.x += 2*(int)ceil(BULLET_SPEED)*cosf(DAb->data[x]->angle/180*PI);
-            DAb->data[x]->dst.y += 2*(int)ceil(BULLET_SPEED)*sinf(DAb->data[x]->angle/180*PI);
+// BULLETS OUT OF THE WINDOW ARE DROPPED, THE OTHERS MOVE BY THEIR VELOCITY. THE CULL TEST USES THE POSITION
+// BEFORE THE MOVE, AS A BULLET IS STILL CHECKED FOR COLLISIONS ON THE FRAME IT LEAVES THE WINDOW
+void animate_bullets(BulletPool *B) {
+    Uint64 gone[MAX_BULLETS/64] = {0};
+    bool any_gone = false;
+    size_t n = B->count;
+    size_t x = 0;
+#if LANES
+    Lanes max_x = LANES_SET(WINDOW_WIDTH);
+    Lanes min_x = LANES_SET(-BULLET_W);
+    Lanes max_y = LANES_SET(WINDOW_HEIGHT);
+    Lanes min_y = LANES_SET(-BULLET_H);
+    for (; x + LANES <= n; x += LANES) {
+        Lanes px = LANES_LOAD(&B->x[x]);
+        Lanes py = LANES_LOAD(&B->y[x]);
+        Lanes out = LANES_OR(
+            LANES_OR(LANES_GE(px, max_x), LANES_LE(px, min_x)),
+            LANES_OR(LANES_GE(py, max_y), LANES_LE(py, min_y)));
+        int mask = LANES_MASK(out);
+        gone[x/64] |= (Uint64)mask << (x%64);
+        any_gone |= mask != 0;
+        LANES_STORE(&B->x[x], LANES_ADD(px, LANES_LOAD(&B->vx[x])));
+        LANES_STORE(&B->y[x], LANES_ADD(py, LANES_LOAD(&B->vy[x])));
+    }
+#endif
+    for (; x < n; x++) {
+        if (B->x[x] >= WINDOW_WIDTH || B->x[x] <= -BULLET_W || B->y[x] >= WINDOW_HEIGHT || B->y[x] <= -BULLET_H) {
+            gone[x/64] |= (Uint64)1 << (x%64);
+            any_gone = true;
         }
+        B->x[x] += B->vx[x];
+        B->y[x] += B->vy[x];
+    }
+    if (!any_gone) return;
+
+    // KEEPS THE POOL PACKED AND IN SPAWN ORDER
+    size_t kept = 0;
+    for (x = 0; x < n; x++) {
+        if (gone[x/64] & ((Uint64)1 << (x%64))) continue;
+        B->x[kept] = B->x[x];
+        B->y[kept] = B->y[x];
+        B->px[kept] = B->px[x];
+        B->py[kept] = B->py[x];
+        B->vx[kept] = B->vx[x];
+        B->vy[kept] = B->vy[x];
+        B->angle[kept] = B->angle[x];
+        kept++;
     }
+    B->count = kept;
 }
 
-void animate_particles(DArrayOfParticlesCLusters *Cluster) {
-    for (size_t x = 0; x < Cluster->size; x++) {
-        DArrayOfParticles *c = Cluster->data[x];
-        if (Cluster->data[x] != NULL) {
-            bool despawn = true;
-            for (size_t y = 0; y < c->size; y++) {
-                Particle* p = c->data[y];
-                if (c->data[y] != NULL) {
-                    if (p->dst.x > 0) despawn = false;
-                    p->vel.y += GRAVITY;
-                    if (p->dst.y >= p->ground_h) {
-                        p->vel.y = -p->vel.y*P_BOUNCINESS;
-                        if (p->vel.y < -p->dst.h) {
-                            p->dst.y -= p->dst.h;
-                        } else {
-                            p->vel.y = 0.f;
-                        }
-                    }
-                    p->dst.y += p->vel.y;
-                    p->dst.x -= p->vel.x;
-                    p->vel.x += (SPEED - p->vel.x)/P_FRICTION;
-                }
-            }
-            if (despawn) {
-                for (size_t i = 0; i < c->size; i++) {
-                    free(c->data[i]);
-                    c->data[i] = NULL;
-                }
-                free(Cluster->data[x]);
-                Cluster->data[x] = NULL;
-                Cluster->count--;
-                continue;
+void remove_bullet(BulletPool *B, size_t i) {
+    size_t last = --B->count;
+    B->x[i] = B->x[last];
+    B->y[i] = B->y[last];
+    B->px[i] = B->px[last];
+    B->py[i] = B->py[last];
+    B->vx[i] = B->vx[last];
+    B->vy[i] = B->vy[last];
+    B->angle[i] = B->angle[last];
+}
+
+// GRAVITY, BOUNCE ON P_GROUND, DRAG TOWARDS THE SCROLLING SPEED. A PARTICLE LEFT OF THE WINDOW BEFORE THE STEP IS DROPPED
+void animate_particles(ParticlePool *P) {
+    Uint64 gone[PARTICLE_POOL/64] = {0};
+    bool any_gone = false;
+    size_t n = P->count;
+    size_t x = 0;
+#if LANES
+    Lanes gravity = LANES_SET(GRAVITY);
+    Lanes ground = LANES_SET(P_GROUND);
+    Lanes bounciness = LANES_SET(-P_BOUNCINESS);
+    Lanes size = LANES_SET(PARTICLE_SIZE);
+    Lanes min_size = LANES_SET(-PARTICLE_SIZE);
+    Lanes zero = LANES_SET(0.f);
+    Lanes speed = LANES_SET(SPEED);
+    Lanes friction = LANES_SET(P_FRICTION);
+    for (; x + LANES <= n; x += LANES) {
+        Lanes px = LANES_LOAD(&P->x[x]);
+        Lanes py = LANES_LOAD(&P->y[x]);
+        Lanes vx = LANES_LOAD(&P->vx[x]);
+        Lanes vy = LANES_ADD(LANES_LOAD(&P->vy[x]), gravity);
+
+        int mask = LANES_MASK(LANES_LE(px, min_size));
+        gone[x/64] |= (Uint64)mask << (x%64);
+        any_gone |= mask != 0;
+
+        Lanes on_ground = LANES_GE(py, ground);
+        Lanes bounced = LANES_MUL(vy, bounciness);
+        Lanes jumps = LANES_LT(bounced, LANES_SUB(zero, size));
+        vy = LANES_SELECT(on_ground, LANES_AND(jumps, bounced), vy);
+        py = LANES_SUB(py, LANES_AND(LANES_AND(on_ground, jumps), size));
+
+        LANES_STORE(&P->y[x], LANES_ADD(py, vy));
+        LANES_STORE(&P->vy[x], vy);
+        LANES_STORE(&P->x[x], LANES_SUB(px, vx));
+        LANES_STORE(&P->vx[x], LANES_ADD(vx, LANES_DIV(LANES_SUB(speed, vx), friction)));
+    }
+#endif
+    for (; x < n; x++) {
+        if (P->x[x] <= -PARTICLE_SIZE) {
+            gone[x/64] |= (Uint64)1 << (x%64);
+            any_gone = true;
+        }
+        P->vy[x] += GRAVITY;
+        if (P->y[x] >= P_GROUND) {
+            P->vy[x] = -P->vy[x]*P_BOUNCINESS;
+            if (P->vy[x] < -PARTICLE_SIZE) {
+                P->y[x] -= PARTICLE_SIZE;
+            } else {
+                P->vy[x] = 0.f;
             }
         }
+        P->y[x] += P->vy[x];
+        P->x[x] -= P->vx[x];
+        P->vx[x] += (SPEED - P->vx[x])/P_FRICTION;
     }
+    if (!any_gone) return;
+
+    size_t kept = 0;
+    for (x = 0; x < n; x++) {
+        if (gone[x/64] & ((Uint64)1 << (x%64))) continue;
+        P->x[kept] = P->x[x];
+        P->y[kept] = P->y[x];
+        P->px[kept] = P->px[x];
+        P->py[kept] = P->py[x];
+        P->vx[kept] = P->vx[x];
+        P->vy[kept] = P->vy[x];
+        kept++;
+    }
+    P->count = kept;
 }
 
-void animate(Assets *A, DArrayOfEntities *DAe, DArrayOfBullets *Bullets, DArrayOfParticlesCLusters *Clusters, State *state, Animations_start *starts, size_t now, Sounds *sounds) {      
-    animate_soil(A);
-    animate_dino(A, starts, now, sounds);
-    animate_entities(A, DAe, starts, now, state, sounds);
-    animate_bullets(Bullets);
-    animate_particles(Clusters);
+void animate(Assets *A, EntityStore *E, BulletPool *Bullets, ParticlePool *Particles, State *state, TimerWheel *timers, Sounds *sounds) {
+    TRACE_ZONE("animate_soil", animate_soil(A));
+    TRACE_ZONE("animate_dino", animate_dino(A, timers, sounds));
+    TRACE_ZONE("animate_entities", animate_entities(A, E, timers, state, sounds));
+    TRACE_ZONE("animate_bullets", animate_bullets(Bullets));
+    TRACE_ZONE("animate_particles", animate_particles(Particles));
 }
 
-void spawn_bird(Assets *A, DA *DAe) {
-    Asset *bird = (Asset*)malloc(sizeof(Asset));
-    if (rand()%2) {
-        bird->txt = A->Bird_Down->txt;
-    } else {
-        bird->txt = A->Bird_Up->txt;
-    }
-    bird->dst = A->Bird_Down->dst;
-    bird->src = A->Bird_Down->src;
-    bird->dst.y = rand() % (WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - BIRD_H * 3);
-    DA_append(DAe, (void*)bird);
-
-}
-
-void spawn_cacti(Assets *A, DA* DAe) {
-    Asset *cactus = (Asset*)malloc(sizeof(Asset));
-    int chose = rand()%3;
-    if (chose == 0) {
-        cactus->src = A->Cactus_1->src;
-        cactus->dst = A->Cactus_1->dst;
-        cactus->txt = A->Cactus_1->txt;
-    } else if (chose == 1){
-        cactus->src = A->Cactus_2->src;
-        cactus->dst = A->Cactus_2->dst;
-        cactus->txt = A->Cactus_2->txt;
-    } else {
-        cactus->src = A->Cactus_3->src;
-        cactus->dst = A->Cactus_3->dst;
-        cactus->txt = A->Cactus_3->txt;
-    }
-    DA_append(DAe, (void*)cactus);
+void spawn_bird(Assets *A, EntityStore *E) {
+    TRACE_INSTANT("spawn_bird");
+    Uint8 frame = rng_below(RNG_SPAWN, 2);
+    SDL_FRect dst = A->Bird_Down->dst;
+    dst.y = rng_below(RNG_SPAWN, WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - BIRD_H * 3);
+    push_entity(E, ENTITY_BIRD, frame, dst);
 }
 
-void spawn_cloud(Assets *A, DA* DAe) {
-    Asset *cloud = (Asset*)malloc(sizeof(Asset));
-    cloud->txt = A->Cloud->txt;
-    cloud->src = A->Cloud->src;
-    cloud->dst = A->Cloud->dst;
-    cloud->dst.y = rand()% (WINDOW_HEIGHT/2);
-    DA_append(DAe, (void*)cloud);
+void spawn_cacti(Assets *A, EntityStore *E) {
+    TRACE_INSTANT("spawn_cacti");
+    Asset *cacti[3] = {A->Cactus_1, A->Cactus_2, A->Cactus_3};
+    int chose = rng_below(RNG_SPAWN, 3);
+    push_entity(E, ENTITY_CACTUS, chose, cacti[chose]->dst);
+}
 
+void spawn_cloud(Assets *A, EntityStore *E) {
+    TRACE_INSTANT("spawn_cloud");
+    SDL_FRect dst = A->Cloud->dst;
+    dst.y = rng_below(RNG_SPAWN, WINDOW_HEIGHT/2);
+    push_entity(E, ENTITY_CLOUD, 0, dst);
 }
 
-void spawn_bullet(Assets *A, DA* DAe, Asset *Gun) {
+void spawn_bullet(BulletPool *B, Asset *Gun) {
+    TRACE_INSTANT("spawn_bullet");
+    if (B->count == MAX_BULLETS) return;
     SDL_FPoint c = {
         .x = GUN_W/8.0f,
         .y = GUN_H*2.0f/3.0f
@@ -913,106 +2412,250 @@ void spawn_bullet(Assets *A, DA* DAe, Asset *Gun) {
     int gun_rot_cx = Gun->dst.x + c.x;
     int gun_rot_cy = Gun->dst.y + c.y;
 
-    AssetRot *a = (AssetRot*)malloc(sizeof(AssetRot));
-
-    a->src = A->Bullet->src;
-    a->dst = A->Bullet->dst;
-    a->srf = A->Bullet->srf;
-    a->txt = A->Bullet->txt;
-
     float angle = get_gun_angle(Gun);
     float angle_rad = (angle/360.f)*2*PI;
-    a->angle = angle;
-    a->rot_c = (SDL_FPoint) {.x=0.f, .y=0.f};
+    size_t i = B->count++;
+    B->angle[i] = angle;
+    B->x[i] = gun_rot_cx + (GUN_W - c.x)*cosf(angle_rad) + (GUN_H - c.y)*sinf(angle_rad) + BULLET_H*sinf(angle_rad);
+    B->y[i] = gun_rot_cy + (GUN_W - c.x)*sinf(angle_rad) - (GUN_H - c.y)*cosf(angle_rad) - BULLET_H*cosf(angle_rad);
+    B->px[i] = B->x[i];
+    B->py[i] = B->y[i];
+    B->vx[i] = 2*(int)ceil(BULLET_SPEED)*cosf(angle/180*PI);
+    B->vy[i] = 2*(int)ceil(BULLET_SPEED)*sinf(angle/180*PI);
+}
 
-    a->dst.x = gun_rot_cx + (GUN_W - c.x)*cosf(angle_rad) + (GUN_H - c.y)*sinf(angle_rad) + BULLET_H*sinf(angle_rad);
-    a->dst.y = gun_rot_cy + (GUN_W - c.x)*sinf(angle_rad) - (GUN_H - c.y)*cosf(angle_rad) - BULLET_H*cosf(angle_rad);
+void spawn_entities(Assets *A, EntityStore *E, TimerWheel *timers) {
+    if (timer_take(timers, TIMER_BIRD_SPAWN)) {
+        spawn_bird(A, E);
+        timer_repeat(timers, TIMER_BIRD_SPAWN);
+    }
+    if (timer_take(timers, TIMER_CACTUS_SPAWN)) {
+        spawn_cacti(A, E);
+        timer_repeat(timers, TIMER_CACTUS_SPAWN);
+    }
+    if (timer_take(timers, TIMER_CLOUD_SPAWN)) {
+        spawn_cloud(A, E);
+        timer_repeat(timers, TIMER_CLOUD_SPAWN);
+    }
+}
 
-    DA_append(DAe, (void*)a);
+void spawn_particles(ParticlePool *P, float cx, float cy) {
+    TRACE_INSTANT("spawn_particles");
+    int n_part = rng_below(RNG_PARTICLES, MAX_PARTICLES-MIN_PARTICLES)+MIN_PARTICLES;
+    for (int x = 0; x < n_part; x++) {
+        float vx = SPEED + (rng_float(RNG_PARTICLES)*SPREAD - (SPREAD/2.0f));
+        float vy = -rng_float(RNG_PARTICLES)*VERTICAL_BUMP;
+        if (P->count == PARTICLE_POOL) continue; // POOL FULL, THE BURST IS SMALLER
+        size_t i = P->count++;
+        P->x[i] = P->px[i] = cx;
+        P->y[i] = P->py[i] = cy;
+        P->vx[i] = vx;
+        P->vy[i] = vy;
+    }
 }
 
-void spawn_entities(Assets *A, DA *DAe, Animations_start *starts, size_t now) {
-    if (now - starts->Bird_spawn >= (size_t)(rand()%15000 + 7500)/(SPEED*(FPS/60.0f))) {
-        spawn_bird(A, DAe);
-        starts->Bird_spawn = SDL_GetTicks();        
-    } else if (starts->Bird_spawn > now) {
-        starts->Bird_spawn = SDL_GetTicks();         
+// SEGMENT FROM WHERE THE BULLET WAS LAST FRAME TO WHERE IT IS NOW AGAINST THE ENTITY'S RECT (LIANG-BARSKY SLABS),
+// SO A BULLET CAN'T JUMP OVER A CACTUS THINNER THAN ITS STEP. THE PART OF THE SEGMENT INSIDE THE RECT IS THEN
+// WALKED ONE PIXEL AT A TIME OVER THE ENTITY'S MASK, A BULLET THROUGH THE GAPS OF A SPRITE MISSES
+bool bullet_hits(const CollisionMask *masks, EntityStore *E, size_t x, BulletPool *B, size_t y) {
+    float x0 = B->x[y] - B->vx[y];
+    float y0 = B->y[y] - B->vy[y];
+    float p[4] = {-B->vx[y], B->vx[y], -B->vy[y], B->vy[y]};
+    float q[4] = {x0 - E->x[x], E->x[x] + E->w[x] - x0, y0 - E->y[x], E->y[x] + E->h[x] - y0};
+    float t0 = 0.f;
+    float t1 = 1.f;
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0.f) {
+            if (q[k] < 0.f) return false;
+            continue;
+        }
+        float t = q[k]/p[k];
+        if (p[k] < 0.f) {
+            if (t > t1) return false;
+            if (t > t0) t0 = t;
+        } else {
+            if (t < t0) return false;
+            if (t < t1) t1 = t;
+        }
     }
-    
-    if (now - starts->Cactus_spawn >= (size_t)(rand()%15000 + 7500)/(SPEED*(FPS/60.0f))) {
-        spawn_cacti(A, DAe);
-        starts->Cactus_spawn = SDL_GetTicks();
-    } else if (starts->Cactus_spawn > now){
-        starts->Cactus_spawn = SDL_GetTicks();
+
+    const CollisionMask *m = &masks[entity_sprite(E, x)];
+    if (m->bits == NULL) return true;
+    float sx = x0 - E->x[x];
+    float sy = y0 - E->y[x];
+    int steps = SDL_max(SDL_fabsf(B->vx[y]), SDL_fabsf(B->vy[y]))*(t1 - t0) + 1;
+    for (int k = 0; k <= steps; k++) {
+        float t = t0 + (t1 - t0)*k/steps;
+        if (mask_pixel(m, SDL_floorf(sx + B->vx[y]*t), SDL_floorf(sy + B->vy[y]*t))) return true;
     }
-    
-    if (now - starts->Cloud_spawn >= (size_t)(rand()%25000 + 5000)/(SPEED*(FPS/60.0f))) {
-        spawn_cloud(A, DAe);
-        starts->Cloud_spawn = SDL_GetTicks();
-    } else if (starts->Cactus_spawn > now){
-        starts->Cloud_spawn = SDL_GetTicks();
+    return false;
+}
+
+// REFERENCE: EVERY ENTITY AGAINST EVERY BULLET. FILLS E->hit, EVERY BULLET HITS AT MOST ONE ENTITY, THE FIRST IN STORE ORDER
+size_t collide_all_pairs(const CollisionMask *masks, EntityStore *E, BulletPool *B, bool *used) {
+    size_t hits = 0;
+    for (size_t x = 0; x < E->count; x++) {
+        E->hit[x] = -1;
+        if (E->type[x] == ENTITY_CLOUD) continue;
+        for (size_t y = 0; y < B->count; y++) {
+            if (!used[y] && bullet_hits(masks, E, x, B, y)) {
+                E->hit[x] = y;
+                used[y] = true;
+                hits++;
+                break;
+            }
+        }
     }
+    return hits;
 }
 
-void spawn_particles(DA *Clusters, float cx, float cy) {
-    DA particles = {
-        .type=DA_TYPE_PARTICLES
-    };
-    init_DA(&particles);
+typedef struct {
+    float x;
+    int i;
+} SweepKey;
+
+int compare_sweep_keys(const void *a, const void *b) {
+    const SweepKey *k1 = (const SweepKey*)a;
+    const SweepKey *k2 = (const SweepKey*)b;
+    if (k1->x != k2->x) return k1->x < k2->x ? -1 : 1;
+    return k1->i - k2->i;
+}
 
-    int n_part = (rand()%(MAX_PARTICLES-MIN_PARTICLES))+MIN_PARTICLES;
-    for (int x = 0; x < n_part; x++) {
-        Particle *p = (Particle*)malloc(sizeof(Particle));
-        p->dst.x = cx;
-        p->dst.y = cy;
-        p->dst.w = PARTICLE_SIZE;
-        p->dst.h = PARTICLE_SIZE;
-        p->vel = (Vec2f){ 
-            .x=SPEED + ((float)rand()/RAND_MAX*SPREAD - (SPREAD/2.0f)), 
-            .y=-(float)rand()/RAND_MAX*VERTICAL_BUMP
-        };
-        p->ground_h = WINDOW_HEIGHT - SOIL_Y + 10;
-        DA_append(&particles, (void*)p);
-    }
-    particles.ptr.DAp->cx = cx;
-    particles.ptr.DAp->cy = cy;
-    DA_append(Clusters, (void*)particles.ptr.DAp);
-}
-
-void check_bcollisions(Assets *A, DArrayOfEntities *DAe, DArrayOfBullets *Bullets, DA *Clusters, State *state, Sounds *sounds) {
-    for (size_t x = 0; x < DAe->size; x++) {
-        for (size_t y = 0; y < Bullets->size; y++) {
-            if (DAe->data[x] && Bullets->data[y] && DAe->data[x]->txt != A->Cloud->txt) {
-                Asset *ent = DAe->data[x];
-                AssetRot *bull = Bullets->data[y]; 
-                float bx = bull->dst.x;
-                float by = bull->dst.y;
-
-                if (bx >= ent->dst.x &&
-                    bx <= ent->dst.x + ent->dst.w &&
-                    by <= ent->dst.y + ent->dst.h &&
-                    by >= ent->dst.y) {
-
-                    if (ent->txt == A->Bird_Down->txt || ent->txt == A->Bird_Up->txt) {
-                        state->POINTS += 20;
-                        Mix_PlayChannel(-1, sounds->bird_death_sound, 0);
-                    } else {
-                        Mix_PlayChannel(-1, sounds->cactus_death_sound, 0);
-                        state->POINTS += 10;
-                    }
-                    
-                    spawn_particles(Clusters, ent->dst.x, ent->dst.y);
-                    free(ent);
-                    DAe->data[x] = NULL;
-                    DAe->count--;
-                    
-                    free(bull);
-                    Bullets->data[y] = NULL;
-                    Bullets->count--;
-                }
+// SORT AND SWEEP ON x: BULLET PATHS SORTED BY THEIR LEFT END, EVERY ENTITY ONLY TESTS THE PATHS STARTING INSIDE
+// [x - longest path, x + w]. SAME RESULT AS collide_all_pairs: AMONG THE CANDIDATES THE LOWEST BULLET INDEX WINS
+size_t collide_sweep(const CollisionMask *masks, EntityStore *E, BulletPool *B, bool *used) {
+    SweepKey keys[MAX_BULLETS];
+    float longest = 0.f;
+    for (size_t y = 0; y < B->count; y++) {
+        float dx = SDL_fabsf(B->vx[y]);
+        keys[y] = (SweepKey){.x = B->vx[y] > 0 ? B->x[y] - dx : B->x[y], .i = y};
+        if (dx > longest) longest = dx;
+    }
+    qsort(keys, B->count, sizeof(SweepKey), compare_sweep_keys);
+
+    size_t hits = 0;
+    for (size_t x = 0; x < E->count; x++) {
+        E->hit[x] = -1;
+        if (E->type[x] == ENTITY_CLOUD) continue;
+        size_t lo = 0;
+        size_t hi = B->count;
+        while (lo < hi) {
+            size_t mid = (lo + hi)/2;
+            if (keys[mid].x < E->x[x] - longest) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        int best = -1;
+        for (size_t k = lo; k < B->count && keys[k].x <= E->x[x] + E->w[x]; k++) {
+            int y = keys[k].i;
+            if (!used[y] && (best < 0 || y < best) && bullet_hits(masks, E, x, B, y)) best = y;
+        }
+        if (best >= 0) {
+            E->hit[x] = best;
+            used[best] = true;
+            hits++;
+        }
+    }
+    return hits;
+}
+
+void check_bcollisions(Assets *A, EntityStore *E, BulletPool *B, ParticlePool *Particles, State *state, Sounds *sounds) {
+    if (E->count == 0 || B->count == 0) return;
+    bool used[MAX_BULLETS] = {0};
+    const CollisionMask *masks = A->Atlas.masks;
+    size_t hits = E->count*B->count < SWEEP_MIN_PAIRS ? collide_all_pairs(masks, E, B, used) : collide_sweep(masks, E, B, used);
+    if (hits == 0) return;
+
+    for (size_t x = 0; x < E->count; x++) {
+        if (E->hit[x] < 0) continue;
+        if (E->type[x] == ENTITY_BIRD) {
+            state->POINTS += 20;
+            Mix_PlayChannel(-1, sounds->bird_death_sound, 0);
+        } else {
+            Mix_PlayChannel(-1, sounds->cactus_death_sound, 0);
+            state->POINTS += 10;
+        }
+        spawn_particles(Particles, E->x[x], E->y[x]);
+    }
+    // FROM THE END, SO THE SLOTS NOT VISITED YET NEVER MOVE
+    for (size_t x = E->count; x-- > 0;) {
+        if (E->hit[x] >= 0) remove_entity(E, x);
+    }
+    for (size_t y = B->count; y-- > 0;) {
+        if (used[y]) remove_bullet(B, y);
+    }
+}
+
+// CROSSOVER BETWEEN collide_all_pairs AND collide_sweep ON RANDOM SCENES OF n ENTITIES AND n BULLETS
+void bench_collisions(unsigned int seed) {
+    seed_rngs(seed);
+    Session session;
+    if (!init_session(&session)) {
+        printf("Could not allocate the session arena\n");
+        return;
+    }
+    // THE SAME MASKS AS THE GAME, THE SPRITES ARE LOADED WITHOUT A RENDERER
+    State state = {0};
+    SpriteAtlas atlas = {0};
+    for (int x = 0; x < N_SPRITES; x++) {
+        atlas.srfs[x] = load_image(SPRITE_SOURCES[x].path);
+        CHECK_ERROR_ptr(atlas.srfs[x], (&state));
+        if (atlas.srfs[x]) atlas.srfs[x] = preprocess_sprite(&state, atlas.srfs[x], &SPRITE_SOURCES[x], SDL_PIXELFORMAT_ARGB8888);
+    }
+    build_collision_masks(&atlas);
+    EntityStore *E = &session.Entities;
+    BulletPool *B = session.Bullets;
+    bool used[MAX_BULLETS];
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    size_t crossover = 0;
+
+    printf("%8s %16s %16s %8s\n", "n", "all pairs us", "sweep us", "hits");
+    for (size_t n = 1; n <= BENCH_COLLISIONS_MAX && n <= MAX_BULLETS; n *= 2) {
+        E->count = 0;
+        for (size_t x = 0; x < n; x++) {
+            EntityType type = rng_below(RNG_SPAWN, N_ENTITY_TYPES);
+            SDL_FRect dst = {.x = rng_below(RNG_SPAWN, WINDOW_WIDTH), .y = rng_below(RNG_SPAWN, WINDOW_HEIGHT), .w = BIRD_W, .h = BIRD_H};
+            if (type == ENTITY_CACTUS) dst = (SDL_FRect){.x = dst.x, .y = WINDOW_HEIGHT - SOIL_HEIGHT - SOIL_Y - CACTUS_H*0.5, .w = CACTUS_2W, .h = CACTUS_H};
+            if (type == ENTITY_CLOUD) dst = (SDL_FRect){.x = dst.x, .y = rng_below(RNG_SPAWN, WINDOW_HEIGHT/2), .w = CLOUD_W, .h = CLOUD_H};
+            push_entity(E, type, type == ENTITY_CACTUS ? 1 : 0, dst);
+        }
+        B->count = n;
+        for (size_t y = 0; y < n; y++) {
+            float angle = rng_below(RNG_SPAWN, 360);
+            B->x[y] = rng_below(RNG_SPAWN, WINDOW_WIDTH);
+            B->y[y] = rng_below(RNG_SPAWN, WINDOW_HEIGHT);
+            B->vx[y] = 2*(int)ceil(BULLET_SPEED)*cosf(angle/180*PI);
+            B->vy[y] = 2*(int)ceil(BULLET_SPEED)*sinf(angle/180*PI);
+        }
+
+        size_t reps = BENCH_COLLISIONS_PAIRS/(n*n) + 1;
+        if (reps > 100000) reps = 100000;
+        size_t hits[2] = {0};
+        Uint64 ticks[2] = {0};
+        for (int method = 0; method < 2; method++) {
+            Uint64 start = SDL_GetPerformanceCounter();
+            for (size_t r = 0; r < reps; r++) {
+                memset(used, 0, sizeof(bool)*n);
+                hits[method] = method ? collide_sweep(atlas.masks, E, B, used) : collide_all_pairs(atlas.masks, E, B, used);
             }
+            ticks[method] = SDL_GetPerformanceCounter() - start;
         }
+        double us[2] = {ticks[0]*1e6/freq/reps, ticks[1]*1e6/freq/reps};
+        printf("%8zu %16.3f %16.3f %8zu%s\n", n, us[0], us[1], hits[1], hits[0] != hits[1] ? "  MISMATCH" : "");
+        if (crossover == 0 && us[1] < us[0]) crossover = n;
+    }
+    if (crossover) {
+        printf("sort and sweep is faster from %zu entities and bullets\n", crossover);
+    } else {
+        printf("sort and sweep never got faster up to %d entities and bullets\n", BENCH_COLLISIONS_MAX);
     }
+    uninit_session(&session);
+    for (int x = 0; x < N_SPRITES; x++) {
+        if (atlas.srfs[x]) SDL_FreeSurface(atlas.srfs[x]);
+    }
+    destroy_collision_masks(&atlas);
 }
 
 void free_sounds(Sounds *sounds) {
@@ -1024,16 +2667,64 @@ void free_sounds(Sounds *sounds) {
     if (sounds->stepr_sound) free(sounds->cactus_death_sound);
 }
 
-void manage_events(State* state, Assets* A, DA *DAe, Sounds *sounds) {
+// SDL EVENT TIMESTAMPS ARE SDL_GetTicks() MS, MOVED ONTO THE PERFORMANCE COUNTER WITH A READING OF BOTH CLOCKS.
+// EVERY SDL_PollEvent PUMPS AGAIN, SO AN EVENT CAN BE NEWER THAN THE READING: IT'S TAKEN AS HAPPENING AT IT.
+// 0 == NO USABLE TIME, THE EVENT ADDS NO LATENCY SAMPLE
+Uint64 event_counter(Uint32 timestamp, Uint64 counter, Uint32 ticks) {
+    Uint64 age = SDL_TICKS_PASSED(timestamp, ticks) ? 0 : (Uint64)(ticks - timestamp)*SDL_GetPerformanceFrequency()/1000;
+    return age < counter ? counter - age : 0;
+}
+
+void manage_events(State* state, Assets* A, BulletPool *Bullets, Sounds *sounds) {
+    SDL_PumpEvents();
+    Uint64 counter = SDL_GetPerformanceCounter();
+    Uint32 ticks = SDL_GetTicks();
+    INPUT.shot_time = 0;
+    INPUT.move_time = 0;
+    INPUT.redraw = false;
+    // THE GAME ONLY NEEDS WHEN THE MOUSE FIRST MOVED, THE MOTION EVENTS ARE TAKEN OUT OF THE QUEUE IN BULK
+    SDL_Event motion[64];
+    int n;
+    while ((n = SDL_PeepEvents(motion, 64, SDL_GETEVENT, SDL_MOUSEMOTION, SDL_MOUSEMOTION)) > 0) {
+        if (INPUT.move_time == 0) INPUT.move_time = event_counter(motion[0].motion.timestamp, counter, ticks);
+    }
+    SDL_GetMouseState(&INPUT.mouse_x, &INPUT.mouse_y);
+
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
             case SDL_QUIT:
                 state->CLOSE = true;
                 break;
+            case SDL_WINDOWEVENT:
+                switch (event.window.event) {
+                    case SDL_WINDOWEVENT_MINIMIZED:
+                    case SDL_WINDOWEVENT_HIDDEN:
+                        // NOBODY CAN PLAY WHAT ISN'T SHOWN
+                        state->HIDDEN = true;
+                        state->PAUSE = true;
+                        break;
+                    case SDL_WINDOWEVENT_SHOWN:
+                    case SDL_WINDOWEVENT_RESTORED:
+                    case SDL_WINDOWEVENT_EXPOSED:
+                        state->HIDDEN = false;
+                        INPUT.redraw = true;
+                        BATCH.FULL_REDRAW = true;
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+                INPUT.redraw = true;
+                BATCH.FULL_REDRAW = true;
+                break;
             case SDL_KEYDOWN:
+                INPUT.redraw = true;
                 switch (event.key.keysym.scancode) {
                     case SDL_SCANCODE_SPACE:
+                        if (!event.key.repeat && INPUT.shot_time == 0) INPUT.shot_time = event_counter(event.key.timestamp, counter, ticks);
                         if (state->START) state->START = false;
                         if (state->PAUSE) {
                             state->PAUSE = false;
@@ -1041,7 +2732,7 @@ void manage_events(State* state, Assets* A, DA *DAe, Sounds *sounds) {
                         }
                         if (state->AMMO > 0 && !state->GAMEOVER && !event.key.repeat) {
                             state->AMMO--;
-                            spawn_bullet(A, DAe, A->Gun);
+                            spawn_bullet(Bullets, A->Gun);
                             Mix_PlayChannel(-1, sounds->shot_sound, 0);
                         }
                         break;
@@ -1062,13 +2753,13 @@ void manage_events(State* state, Assets* A, DA *DAe, Sounds *sounds) {
                         state->VOLUME = state->VOLUME + VOLUME_STEP < MIX_MAX_VOLUME ? state->VOLUME + VOLUME_STEP : MIX_MAX_VOLUME;
 
                         #define CHOOSE_VOL_ICON if (state->VOLUME == 0){          \
-                                    A->Vol->txt = A->Volume_zero->txt;            \
+                                    set_sprite(A, A->Vol, SPRITE_VOL_ZERO);       \
                                 } else if (state->VOLUME <= MIX_MAX_VOLUME / 2) { \
-                                    A->Vol->txt = A->Volume_low->txt;             \
+                                    set_sprite(A, A->Vol, SPRITE_VOL_LOW);        \
                                 } else if (state->VOLUME < MIX_MAX_VOLUME) {      \
-                                    A->Vol->txt = A->Volume_mid->txt;             \
+                                    set_sprite(A, A->Vol, SPRITE_VOL_MID);        \
                                 } else if (state->VOLUME == MIX_MAX_VOLUME) {     \
-                                    A->Vol->txt = A->Volume_max->txt;             \
+                                    set_sprite(A, A->Vol, SPRITE_VOL_MAX);        \
                                 }                                                 \
                         
                         CHOOSE_VOL_ICON
@@ -1103,6 +2794,9 @@ void manage_events(State* state, Assets* A, DA *DAe, Sounds *sounds) {
 
                         Mix_MasterVolume(state->VOLUME);
                         break;
+                    case SDL_SCANCODE_F3:
+                        PROF.SHOW = !PROF.SHOW;
+                        break;
                     case SDL_SCANCODE_ESCAPE:
                         if (state->GAMEOVER) {
                             state->CLOSE = true;
@@ -1125,56 +2819,227 @@ void manage_events(State* state, Assets* A, DA *DAe, Sounds *sounds) {
 
 void increment_speed() {
     if (SPEED_CAP != 0.f && SPEED >= SPEED_CAP) return;
-    SPEED += INCREMENTAL_SPEED/FPS/(FPS/60.0f);
+    SPEED += INCREMENTAL_SPEED/TICK_RATE/(TICK_RATE/60.0f);
+}
+
+// POSITIONS OF THE TICK ABOUT TO BE SIMULATED BECOME THE PREVIOUS ONES
+void save_previous(Session *S, Assets *A) {
+    EntityStore *E = &S->Entities;
+    SDL_memcpy(E->px, E->x, sizeof(float)*E->count);
+    SDL_memcpy(E->py, E->y, sizeof(float)*E->count);
+    SDL_memcpy(S->Bullets->px, S->Bullets->x, sizeof(float)*S->Bullets->count);
+    SDL_memcpy(S->Bullets->py, S->Bullets->y, sizeof(float)*S->Bullets->count);
+    SDL_memcpy(S->Particles->px, S->Particles->x, sizeof(float)*S->Particles->count);
+    SDL_memcpy(S->Particles->py, S->Particles->y, sizeof(float)*S->Particles->count);
+    A->Back_1->prev_x = A->Back_1->dst.x;
+    A->Back_2->prev_x = A->Back_2->dst.x;
+}
+
+// ONE FIXED STEP OF 1/TICK_RATE S
+void simulate(State *state, Session *S, TimerWheel *timers, Assets *A, Sounds *sounds) {
+    EntityStore *E = &S->Entities;
+    save_previous(S, A);
+    timers_advance(timers);
+    PROFILE(PHASE_SPAWN, spawn_entities(A, E, timers));
+    PROFILE(PHASE_ANIMATE, animate(A, E, S->Bullets, S->Particles, state, timers, sounds));
+    PROFILE(PHASE_COLLISIONS, check_bcollisions(A, E, S->Bullets, S->Particles, state, sounds));
+    // WITH FULL AMMO THE FIRED TIMER STAYS PENDING, THE NEXT SHOT IS REFILLED AT ONCE IF THE INTERVAL HAS PASSED
+    if (state->AMMO < 10 && timer_take(timers, TIMER_AMMO)) {
+        state->AMMO++;
+        timer_repeat(timers, TIMER_AMMO);
+    }
+    increment_speed();
 }
 
-void handle(State *state, SDL_Renderer *renderer, DA *DA_e, DA *DA_b, DA *DA_pc, Animations_start *starts, Assets *A, TTF_Font *font, Sounds *sounds) {
+void handle(State *state, SDL_Renderer *renderer, Session *session, SimClock *clock, Uint64 now, TimerWheel *timers, Assets *A, TextCache *texts, Sounds *sounds) {
     if (state->RESTART) {
         state->RESTART = false;
         state->PAUSE = false;
         state->POINTS = 0;
         state->AMMO = 0;
-        SPEED = START_SPEED/(FPS/60.f);
-        free_particles(DA_pc->ptr.DApc);
-        uninit_DA(DA_e);
-        uninit_DA(DA_b);
-        uninit_DA(DA_pc);
-        init_DA(DA_e);
-        init_DA(DA_b);
-        init_DA(DA_pc);
+        SPEED = START_SPEED/(TICK_RATE/60.f);
+        TRACE_BEGIN("restart");
+        start_session(session);
+        timers_reset(timers);
+        schedule_game_timers(timers);
+        clock->acc = 0;
+        clock->alpha = 0.f;
+        TRACE_END("restart");
         return;
     }
 
-    display(state, renderer, DA_e->ptr.DAe, DA_b->ptr.DAb, DA_pc->ptr.DApc, A, font);
-    if (state->START) {
-        state->PAUSE = true;
-        display_start(renderer, state, font);
-    }
-
-    if (!state->PAUSE && !state->GAMEOVER) {
-        spawn_entities(A, DA_e, starts, SDL_GetTicks());
-        animate(A, DA_e->ptr.DAe, DA_b->ptr.DAb, DA_pc->ptr.DApc, state, starts, SDL_GetTicks(), sounds);
-        check_bcollisions(A, DA_e->ptr.DAe, DA_b->ptr.DAb, DA_pc, state, sounds);
-        size_t now = SDL_GetTicks();
-        if (now - starts->Last_added_bullet >= 3500/(SPEED*(FPS/60.0f)) && state->AMMO < 10) {
-            state->AMMO++;
-            starts->Last_added_bullet = now;
+    if (state->START) state->PAUSE = true;
+    sim_clock_frame(clock, now, !state->PAUSE && !state->GAMEOVER);
+    while (clock->acc >= clock->tick && !state->PAUSE && !state->GAMEOVER) {
+        simulate(state, session, timers, A, sounds);
+        clock->acc -= clock->tick;
+    }
+    // PAUSED OR OVER acc STANDS STILL, THE SCENE STAYS WHERE IT WAS DRAWN LAST
+    if (!state->PAUSE && !state->GAMEOVER) clock->alpha = (float)clock->acc/clock->tick;
+
+    display(state, &session->Entities, session->Bullets, session->Particles, A, texts, clock->alpha);
+    // WITH THE GUN AND THE SIGHT DRAWN LAST THE OVERLAY COMES AFTER THEM, FROM display_late_latch
+    if (!state->LATE_LATCH && !state->IDLE) display_overlay(renderer, state, texts);
+    if (state->GAMEOVER) state->PAUSE = true;
+}
+
+void parse_options(int argc, char *argv[], Options *opts) {
+    for (int x = 1; x < argc; x++) {
+        if (SDL_strcmp(argv[x], "--bench") == 0) {
+            opts->BENCH = true;
+        } else if (SDL_strcmp(argv[x], "--frames") == 0 && x + 1 < argc) {
+            opts->FRAMES = SDL_strtoul(argv[++x], NULL, 10);
+        } else if (SDL_strcmp(argv[x], "--seed") == 0 && x + 1 < argc) {
+            opts->SEED = SDL_strtoul(argv[++x], NULL, 10);
+        } else if (SDL_strcmp(argv[x], "--renderer") == 0 && x + 1 < argc) {
+            opts->RENDERER = argv[++x];
+        } else if (SDL_strcmp(argv[x], "--vsync") == 0) {
+            opts->VSYNC = true;
+        } else if (SDL_strcmp(argv[x], "--target-texture") == 0) {
+            opts->TARGET_TEXTURE = true;
+        } else if (SDL_strcmp(argv[x], "--rotations") == 0 && x + 1 < argc) {
+            opts->ROTATIONS = SDL_atoi(argv[++x]);
+        } else if (SDL_strcmp(argv[x], "--bench-collisions") == 0) {
+            opts->BENCH_COLLISIONS = true;
+        } else if (SDL_strcmp(argv[x], "--dirty-rects") == 0) {
+            opts->DIRTY_RECTS = true;
+        } else if (SDL_strcmp(argv[x], "--late-latch") == 0) {
+            opts->LATE_LATCH = true;
+        } else if (SDL_strcmp(argv[x], "--hw-cursor") == 0) {
+            opts->HW_CURSOR = true;
+        } else {
+            printf("Unknown option: %s\n", argv[x]);
+            printf("Usage: %s [--bench] [--frames N] [--seed N] [--renderer auto|software|opengl|opengles2|...|all] [--vsync] [--target-texture] [--dirty-rects] [--late-latch] [--hw-cursor] [--rotations N] [--bench-collisions]\n", argv[0]);
+            exit(1);
         }
-        increment_speed();
-    } else if (!state->START && !state->GAMEOVER){
-        display_menu(renderer, state, font);
-        display_pause(renderer, state, font);
-    } else if (state->GAMEOVER){
-        display_gameover(renderer, state, font);
-        state->PAUSE = true;
-    } else {
-        display_menu(renderer, state, font);
+    }
+    if (SDL_strcmp(opts->RENDERER, "all") == 0 && !opts->BENCH) {
+        printf("--renderer all is only valid with --bench\n");
+        exit(1);
+    }
+    if (opts->DIRTY_RECTS && (SDL_strcmp(opts->RENDERER, "software") != 0 || opts->TARGET_TEXTURE || opts->VSYNC)) {
+        printf("--dirty-rects needs --renderer software, without --target-texture and --vsync\n");
+        exit(1);
+    }
+    if (opts->DIRTY_RECTS && opts->LATE_LATCH) {
+        // THE DAMAGE OF A FRAME IS WORKED OUT FROM ONE FLUSH
+        printf("--late-latch can't be used with --dirty-rects\n");
+        exit(1);
     }
 }
 
-int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
+int find_render_driver(const char *name) {
+    for (int x = 0; x < SDL_GetNumRenderDrivers(); x++) {
+        SDL_RendererInfo info;
+        if (SDL_GetRenderDriverInfo(x, &info) == 0 && SDL_strcmp(info.name, name) == 0) return x;
+    }
+    return -1;
+}
+
+// "auto" LETS SDL PICK AN ACCELERATED BACKEND, ANY BACKEND FALLS BACK TO SOFTWARE IF IT CAN'T BE CREATED
+SDL_Renderer *create_renderer(SDL_Window *window, Options *opts) {
+    Uint32 flags = 0;
+    if (opts->VSYNC) flags |= SDL_RENDERER_PRESENTVSYNC;
+    if (opts->TARGET_TEXTURE) flags |= SDL_RENDERER_TARGETTEXTURE;
+
+    SDL_Renderer *renderer = NULL;
+    if (opts->DIRTY_RECTS) {
+        // THE WINDOW SURFACE KEEPS LAST FRAME'S PIXELS, SDL_RenderPresent WOULD COPY ALL OF IT
+        SDL_Surface *srf = SDL_GetWindowSurface(window);
+        return srf ? SDL_CreateSoftwareRenderer(srf) : NULL;
+    }
+    if (SDL_strcmp(opts->RENDERER, "auto") == 0) {
+        renderer = SDL_CreateRenderer(window, -1, flags | SDL_RENDERER_ACCELERATED);
+    } else if (SDL_strcmp(opts->RENDERER, "software") != 0) {
+        int index = find_render_driver(opts->RENDERER);
+        if (index < 0) {
+            printf("Renderer %s is not available\n", opts->RENDERER);
+        } else {
+            renderer = SDL_CreateRenderer(window, index, flags);
+        }
+    }
+    if (renderer == NULL) {
+        if (SDL_strcmp(opts->RENDERER, "software") != 0) printf("Falling back to the software renderer: %s\n", SDL_GetError());
+        renderer = SDL_CreateRenderer(window, -1, flags | SDL_RENDERER_SOFTWARE);
+    }
+    return renderer;
+}
+
+void push_key(SDL_Scancode code) {
+    SDL_Event event = {0};
+    event.type = SDL_KEYDOWN;
+    event.key.state = SDL_PRESSED;
+    event.key.keysym.scancode = code;
+    SDL_PushEvent(&event);
+}
+
+// SCRIPTED SCENARIO: START, THEN SWEEP THE SIGHT OVER THE SKY AND SHOOT EVERY BENCH_SHOT_EVERY FRAMES, RESTART ON GAMEOVER
+void bench_script(State *state, SDL_Window *window, size_t frame) {
+    if (frame == 0) {
+        push_key(SDL_SCANCODE_SPACE);
+        return;
+    }
+    if (state->GAMEOVER) {
+        push_key(SDL_SCANCODE_R);
+        return;
+    }
+    int aim_x = WINDOW_WIDTH*3/4;
+    int aim_y = WINDOW_HEIGHT/2 + sinf(frame/40.0f)*WINDOW_HEIGHT/3;
+    SDL_WarpMouseInWindow(window, aim_x, aim_y);
+    if (frame % BENCH_SHOT_EVERY == 0) push_key(SDL_SCANCODE_SPACE);
+}
+
+void bench_report(Bench *bench, Options *opts) {
+    if (bench->frames == 0) return;
+    double freq = SDL_GetPerformanceFrequency();
+    double total = (bench->end - bench->start)/freq;
+
+    qsort(bench->handle_times, bench->frames, sizeof(Uint64), compare_u64);
+    double sum = 0;
+    for (size_t x = 0; x < bench->frames; x++) sum += bench->handle_times[x];
+
+    #define BENCH_MS(ticks) ((ticks)*1000.0/freq)
+    #define BENCH_PCT(p) BENCH_MS(bench->handle_times[(bench->frames - 1)*(p)/100])
+    bench->fps = bench->frames/total;
+    bench->handle_avg = BENCH_MS(sum/bench->frames);
+    bench->handle_p99 = BENCH_PCT(99);
+    printf("bench: %s, %zu frames in %.3f s, %.1f fps (seed %u)\n", bench->renderer, bench->frames, total, bench->fps, opts->SEED);
+    printf("handle() ms: min %.3f  avg %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+        BENCH_MS(bench->handle_times[0]),
+        BENCH_MS(sum/bench->frames),
+        BENCH_PCT(50),
+        BENCH_PCT(90),
+        BENCH_PCT(99),
+        BENCH_MS(bench->handle_times[bench->frames - 1]));
+
+    printf("Draw calls per frame: %.2f\n", (double)BATCH.flushes/bench->frames);
+    if (BATCH.DIRTY) printf("Window repainted per frame: %.1f%%\n", 100.0*BATCH.repainted/bench->frames/(WINDOW_WIDTH*WINDOW_HEIGHT));
+
+    if (PROF.frames == 0) return;
+    printf("phase avg ms:\n");
+    for (int x = 0; x < N_PHASES; x++) {
+        printf("  %-18s %.4f\n", PHASE_NAMES[x], BENCH_MS((double)PROF.totals[x]/PROF.frames));
+    }
+    printf("input latency avg ms:\n");
+    for (int x = 0; x < N_LATENCIES; x++) {
+        if (PROF.latency_count[x] == 0) continue;
+        printf("  %-18s %.4f (%zu samples)\n", LATENCY_NAMES[x], BENCH_MS((double)PROF.latency_totals[x]/PROF.latency_count[x]), PROF.latency_count[x]);
+    }
+}
+
+// NOTHING MOVES ON THESE SCREENS. THE BENCH KEEPS DRAWING EVERY FRAME, AND SO DOES THE LIVE PROFILER OVERLAY
+bool idle_screen(State *state, Options *opts) {
+    return (state->START || state->PAUSE || state->GAMEOVER) && !state->RESTART && !PROF.SHOW && !opts->BENCH;
+}
+
+void idle_init(IdleScreen *I, SDL_Renderer *renderer, Options *opts) {
+    memset(I, 0, sizeof(*I));
+    if (opts->DIRTY_RECTS || !SDL_RenderTargetSupported(renderer)) return;
+    I->txt = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+    if (I->txt == NULL) LOG("No idle screen cache (%s)", SDL_GetError());
+}
+
+int run(Options *opts, Bench *bench) {
     State GameState = {
         .MUTE_VOLUME = 0,
         .VOLUME = SDL_MIX_MAXVOLUME,
@@ -1184,43 +3049,57 @@ int main(int argc, char *argv[]) {
         .PAUSE = false,
         .RESTART = false,
         .START = true,
+        .LATE_LATCH = opts->LATE_LATCH,
     };
     State *GSptr = &GameState;
 
-    CHECK_ERROR_int(SDL_Init(SDL_INIT_EVERYTHING), GSptr);
-    CHECK_ERROR_int(TTF_Init(), GSptr);
-    CHECK_ERROR_int(Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 2, 128), GSptr);
-    SDL_ShowCursor(false);
+    SPEED = START_SPEED/(TICK_RATE/60.0f);
+    BULLET_SPEED = START_SPEED_B/(TICK_RATE/60.0f);
+    VIRTUAL_COUNTER = 0;
+    memset(&PROF, 0, sizeof(PROF));
 
     SDL_Window* window = SDL_CreateWindow("Texas T-REX", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_SOFTWARE);
     if (window == NULL) {
         printf("No window pointer\n");
         return 1;
     }
-    srand(time(NULL));
+    SDL_Renderer* renderer = create_renderer(window, opts);
+    if (renderer == NULL) {
+        printf("No renderer pointer: %s\n", SDL_GetError());
+        SDL_DestroyWindow(window);
+        return 1;
+    }
+    SDL_RendererInfo info;
+    CHECK_ERROR_int(SDL_GetRendererInfo(renderer, &info), GSptr);
+    SDL_strlcpy(bench->renderer, info.name, sizeof(bench->renderer));
+    if (opts->BENCH && SDL_strcmp(opts->RENDERER, "auto") != 0 && SDL_strcmp(opts->RENDERER, info.name) != 0) {
+        // NEVER REPORT THE FALLBACK'S NUMBERS UNDER THE REQUESTED BACKEND
+        printf("Skipping %s: got %s instead\n", opts->RENDERER, info.name);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        return 1;
+    }
+    LOG("Renderer: %s%s%s%s", info.name, opts->VSYNC ? ", vsync" : "", opts->TARGET_TEXTURE ? ", target texture" : "", opts->DIRTY_RECTS ? ", dirty rects" : "");
 
+    SDL_Texture *target = NULL;
+    if (opts->TARGET_TEXTURE) {
+        target = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, WINDOW_WIDTH, WINDOW_HEIGHT);
+        CHECK_ERROR_ptr(target, GSptr);
+    }
+    seed_rngs(opts->SEED);
     Assets GameAssets = {0};
-    DA DAe = {
-        .type=DA_TYPE_ENTITIES
-    };
-    DA Bullets = {
-        .type=DA_TYPE_BULLETS
-    };
+    Session GameSession;
+    if (!init_session(&GameSession)) {
+        printf("Could not allocate the session arena\n");
+        GameState.CLOSE = true;
+    }
 
-    DA Clusters = {
-        .type=DA_TYPE_CLUSTERS
-    };
+    TimerWheel Timers;
+    timers_reset(&Timers);
+    schedule_game_timers(&Timers);
+    SimClock Clock;
+    sim_clock_init(&Clock, clock_counter());
 
-    Animations_start Starts = {
-        .Dino_start = SDL_GetTicks(),
-        .Bird_spawn = SDL_GetTicks(),
-        .Bird_flap = SDL_GetTicks(),
-        .Cactus_spawn = SDL_GetTicks(),
-        .Cloud_spawn = SDL_GetTicks(),
-        .Last_added_bullet = 0.0f
-    };
-    
     Sounds GameSounds = {
         .shot_sound = Mix_LoadWAV("./assets/sound/shot.wav"),
         .death_sound = Mix_LoadWAV("./assets/sound/death.wav"),
@@ -1230,38 +3109,232 @@ int main(int argc, char *argv[]) {
         .cactus_death_sound = Mix_LoadWAV("./assets/sound/cactus_death.wav"),
     };
 
-    TTF_Font *font = TTF_OpenFont("./assets/font/Muli-Bold.ttf", 120);
-    CHECK_ERROR_ptr(font, GSptr);
-
-    init_assets(renderer, &GameAssets);
-    init_DA(&DAe);
-    init_DA(&Bullets);
-    init_DA(&Clusters);
+    TextCache Texts = {0};
+    Texts.font = TTF_OpenFont("./assets/font/Muli-Bold.ttf", FONT_SIZE);
+    CHECK_ERROR_ptr(Texts.font, GSptr);
+    PROF.font = TTF_OpenFont("./assets/font/Muli-Bold.ttf", PROF_FONT_SIZE);
+    CHECK_ERROR_ptr(PROF.font, GSptr);
+
+    init_batch(renderer, window, opts->DIRTY_RECTS);
+    init_assets(renderer, GSptr, &GameAssets);
+    build_rotation_cache(renderer, GSptr, &GameAssets, opts->ROTATIONS);
+    validate_text_cache(renderer, GSptr, &Texts);
+
+    // THE CURSOR'S HOTSPOT IS THE MIDDLE OF THE SIGHT, WITHOUT THE PULL TOWARDS THE GUN OF display_gsight
+    SDL_Cursor *cursor = NULL;
+    if (opts->HW_CURSOR && GameAssets.Atlas.srfs[SPRITE_GSIGHT]) {
+        cursor = SDL_CreateColorCursor(GameAssets.Atlas.srfs[SPRITE_GSIGHT], GSIGHT_W/2, GSIGHT_H/2);
+        if (cursor) {
+            SDL_SetCursor(cursor);
+            SDL_ShowCursor(true);
+            GameState.HW_CURSOR = true;
+        } else {
+            LOG("No hardware cursor (%s), drawing the sight", SDL_GetError());
+        }
+    }
 
+    bool prof_shown = false;
+    bench->frames = 0;
+    bench->start = SDL_GetPerformanceCounter();
+    FramePacer Pacer;
+    pacer_init(&Pacer, bench->start);
+    Uint64 last_start = bench->start;
+    IdleScreen Idle;
+    idle_init(&Idle, renderer, opts);
     while (!GameState.CLOSE) {
-        size_t t1 = SDL_GetTicks();
-       
+        bool hidden = GameState.HIDDEN && !opts->BENCH;
+        // NOTHING TO DRAW UNTIL SOMETHING HAPPENS, THE EVENT STAYS IN THE QUEUE FOR manage_events
+        if (hidden || (Idle.PRESENTED && idle_screen(&GameState, opts))) {
+            Uint64 wait_start = SDL_GetPerformanceCounter();
+            SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS);
+            // THE SLEEP IS NOT PART OF THE FRAME INTERVAL, AND THE NEXT DEADLINE COUNTS FROM THE WAKE-UP
+            Uint64 woke = SDL_GetPerformanceCounter();
+            last_start += woke - wait_start;
+            pacer_init(&Pacer, woke);
+        }
+        Uint64 frame_start = SDL_GetPerformanceCounter();
+        PROF.current[PHASE_FRAME_INTERVAL] = frame_start - last_start;
+        last_start = frame_start;
+        TRACE_BEGIN("frame");
+        if (opts->BENCH) {
+            VIRTUAL_COUNTER = bench->frames*SDL_GetPerformanceFrequency()/FPS;
+            bench_script(&GameState, window, bench->frames);
+        }
+        // THE ONE CLOCK READING THE SIMULATION OF THIS FRAME GOES BY
+        Uint64 now = VIRTUAL_CLOCK ? VIRTUAL_COUNTER : frame_start;
+
+        // INPUT IS SAMPLED ONCE, RIGHT BEFORE THE SIMULATION THAT USES IT
+        PROFILE(PHASE_EVENTS, manage_events(&GameState, &GameAssets, GameSession.Bullets, &GameSounds));
+        bool idle = idle_screen(&GameState, opts);
+        if (!idle || INPUT.redraw) {
+            Idle.VALID = false;
+            Idle.PRESENTED = false;
+        }
+        hidden = GameState.HIDDEN && !opts->BENCH;
+        if (hidden || (idle && Idle.PRESENTED && INPUT.move_time == 0)) {
+            // PAUSED TIME IS NOT BANKED, SAME AS IN handle
+            sim_clock_frame(&Clock, now, false);
+            // NOT A FRAME, ITS EVENTS TIME MUST NOT END UP IN THE NEXT ONE
+            memset(PROF.current, 0, sizeof(PROF.current));
+            pacer_init(&Pacer, SDL_GetPerformanceCounter());
+            TRACE_END("frame");
+            continue;
+        }
+        GameState.IDLE = idle && Idle.txt;
+        if (GameState.IDLE && !Idle.VALID) {
+            // THE SCENE IS DRAWN ONCE INTO THE CACHE, EVERY REDRAW COPIES IT AND PUTS GUN, SIGHT AND MENU TEXT ON TOP
+            CHECK_ERROR_int(SDL_SetRenderTarget(renderer, Idle.txt), GSptr);
+            SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+            SDL_RenderClear(renderer);
+            TRACE_ZONE("handle", handle(&GameState, renderer,
+                &GameSession, &Clock, now,
+                &Timers, &GameAssets, &Texts, &GameSounds));
+            PROFILE(PHASE_BATCH_FLUSH, batch_flush(GSptr));
+            CHECK_ERROR_int(SDL_SetRenderTarget(renderer, target), GSptr);
+            Idle.VALID = true;
+        }
+        if (target) CHECK_ERROR_int(SDL_SetRenderTarget(renderer, target), GSptr);
         SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        SDL_RenderClear(renderer);
-
-        manage_events(&GameState, &GameAssets, &Bullets, &GameSounds);
-        handle(&GameState, renderer,
-            &DAe, &Bullets, &Clusters,
-            &Starts, &GameAssets, font, &GameSounds);
+        if (!BATCH.DIRTY) SDL_RenderClear(renderer);
+
+        Uint64 h1 = SDL_GetPerformanceCounter();
+        if (GameState.IDLE) {
+            sim_clock_frame(&Clock, now, false);
+            CHECK_ERROR_int(SDL_RenderCopy(renderer, Idle.txt, NULL, NULL), GSptr);
+        } else {
+            TRACE_ZONE("handle", handle(&GameState, renderer,
+                &GameSession, &Clock, now,
+                &Timers, &GameAssets, &Texts, &GameSounds));
+        }
+        // THE OVERLAY IS DRAWN OUTSIDE THE BATCH, REPAINT EVERYTHING WHILE IT'S ON AND ONCE AFTER IT GOES AWAY
+        if (PROF.SHOW || prof_shown) BATCH.FULL_REDRAW = true;
+        prof_shown = PROF.SHOW;
+        PROFILE(PHASE_BATCH_FLUSH, batch_flush(GSptr));
+        Uint64 h2 = SDL_GetPerformanceCounter();
+        if (GameState.LATE_LATCH || GameState.IDLE) display_late_latch(renderer, &GameState, &GameAssets, &Texts);
+        PROFILE(PHASE_DISPLAY_PROFILER, display_profiler(&GameState, renderer, &GameSession.Entities, GameSession.Bullets, GameSession.Particles));
+        if (target) {
+            CHECK_ERROR_int(SDL_SetRenderTarget(renderer, NULL), GSptr);
+            CHECK_ERROR_int(SDL_RenderCopy(renderer, target, NULL, NULL), GSptr);
+        }
         
-        SDL_RenderPresent(renderer);
-        size_t t2 = SDL_GetTicks();
-        cap_fps(t1, t2);
+        PROFILE(PHASE_PRESENT, present_frame(renderer, GSptr));
+        Uint64 presented = SDL_GetPerformanceCounter();
+        record_latency(LATENCY_SHOT, INPUT.shot_time, presented);
+        record_latency(LATENCY_AIM, INPUT.move_time, presented);
+        PROF.current[PHASE_FRAME] = presented - frame_start;
+        Idle.PRESENTED = idle;
+        profiler_end_frame();
+        TRACE_END("frame");
+        TRACE_COUNTER("entities", GameSession.Entities.count);
+        TRACE_COUNTER("bullets", GameSession.Bullets->count);
+        TRACE_COUNTER("particles", GameSession.Particles->count);
+        if (opts->BENCH) {
+            bench->handle_times[bench->frames++] = h2 - h1;
+            if (bench->frames == opts->FRAMES) GameState.CLOSE = true;
+            continue;
+        }
+        pacer_wait(&Pacer);
+        PROF.current[PHASE_PACE_ERROR] = Pacer.error;
     }
+    bench->end = SDL_GetPerformanceCounter();
+    if (opts->BENCH) bench_report(bench, opts);
     free_sounds(&GameSounds);    
-    TTF_CloseFont(font);
+    destroy_text_cache(&Texts);
+    if (Texts.font) TTF_CloseFont(Texts.font);
+    if (PROF.font) TTF_CloseFont(PROF.font);
+    if (cursor) {
+        SDL_ShowCursor(false);
+        SDL_FreeCursor(cursor);
+    }
+    if (Idle.txt) SDL_DestroyTexture(Idle.txt);
     destroy_assets(&GameAssets);
-    uninit_DA(&DAe);
-    uninit_DA(&Bullets);
-    free_particles(Clusters.ptr.DApc);
-    uninit_DA(&Clusters);
-    SDL_DestroyWindow(window);
+    uninit_session(&GameSession);
+    if (target) SDL_DestroyTexture(target);
+    uninit_batch();
     SDL_DestroyRenderer(renderer);
-    SDL_Quit();
+    SDL_DestroyWindow(window);
     return 0;
+}
+
+int main(int argc, char *argv[]) {
+    Options opts = {
+        .BENCH = false,
+        .FRAMES = BENCH_FRAMES,
+        .SEED = 0, // 0 == NOT GIVEN
+        .RENDERER = "software",
+        .VSYNC = false,
+        .TARGET_TEXTURE = false,
+        .DIRTY_RECTS = false,
+        .ROTATIONS = ROTATION_STEPS,
+        .BENCH_COLLISIONS = false,
+        .LATE_LATCH = false,
+        .HW_CURSOR = false,
+    };
+    parse_options(argc, argv, &opts);
+    if (opts.SEED == 0) opts.SEED = opts.BENCH || opts.BENCH_COLLISIONS ? BENCH_SEED : time(NULL);
+    if (opts.FRAMES == 0) opts.FRAMES = BENCH_FRAMES;
+    if (opts.BENCH_COLLISIONS) {
+        bench_collisions(opts.SEED);
+        return 0;
+    }
+
+    State InitState = {0};
+    State *GSptr = &InitState;
+    Bench bench = {0};
+    if (opts.BENCH) {
+        // offscreen CAN CREATE GL CONTEXTS THROUGH EGL (E.G. MESA llvmpipe), dummy CAN'T
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "offscreen,dummy");
+        SDL_SetHint(SDL_HINT_AUDIODRIVER, "dummy");
+        VIRTUAL_CLOCK = true;
+        bench.handle_times = (Uint64*)malloc(sizeof(Uint64)*opts.FRAMES);
+        if (bench.handle_times == NULL) {
+            printf("Could not allocate the timings of %zu frames\n", opts.FRAMES);
+            return 1;
+        }
+    }
+
+    CHECK_ERROR_int(SDL_Init(SDL_INIT_EVERYTHING), GSptr);
+    TRACE_OPEN();
+    CHECK_ERROR_int(TTF_Init(), GSptr);
+    CHECK_ERROR_int(Mix_OpenAudio(MIX_DEFAULT_FREQUENCY, MIX_DEFAULT_FORMAT, 2, 128), GSptr);
+    SDL_ShowCursor(false);
+    // EVENTS THE GAME NEVER READS ARE DROPPED BEFORE THEY REACH THE QUEUE
+    const Uint32 ignored[] = {
+        SDL_KEYUP, SDL_TEXTINPUT, SDL_TEXTEDITING,
+        SDL_MOUSEBUTTONDOWN, SDL_MOUSEBUTTONUP, SDL_MOUSEWHEEL,
+        SDL_FINGERDOWN, SDL_FINGERUP, SDL_FINGERMOTION,
+    };
+    for (size_t x = 0; x < sizeof(ignored)/sizeof(ignored[0]); x++) SDL_EventState(ignored[x], SDL_IGNORE);
+
+    int result = 0;
+    if (SDL_strcmp(opts.RENDERER, "all") == 0) {
+        // SAME SCRIPTED SCENE ON EVERY BACKEND SDL WAS BUILT WITH, BACKENDS THAT CAN'T START ARE SKIPPED
+        int n = SDL_GetNumRenderDrivers();
+        Bench *results = (Bench*)calloc(n, sizeof(Bench));
+        SDL_RendererInfo *infos = (SDL_RendererInfo*)calloc(n, sizeof(SDL_RendererInfo));
+        for (int x = 0; x < n; x++) {
+            if (SDL_GetRenderDriverInfo(x, &infos[x]) != 0) continue;
+            printf("\n== %s ==\n", infos[x].name);
+            opts.RENDERER = infos[x].name;
+            results[x].handle_times = bench.handle_times;
+            run(&opts, &results[x]);
+        }
+        printf("\n%-12s %10s %14s %14s\n", "backend", "fps", "handle avg ms", "handle p99 ms");
+        for (int x = 0; x < n; x++) {
+            if (results[x].frames == 0) {
+                printf("%-12s %10s\n", infos[x].name, "unavailable");
+                continue;
+            }
+            printf("%-12s %10.1f %14.3f %14.3f\n", results[x].renderer, results[x].fps, results[x].handle_avg, results[x].handle_p99);
+        }
+        free(results);
+        free(infos);
+    } else {
+        result = run(&opts, &bench);
+    }
+    if (bench.handle_times) free(bench.handle_times);
+    TRACE_CLOSE();
+    SDL_Quit();
+    return result;
 }
\ No newline at end of file